@@ -0,0 +1,60 @@
+#pragma once
+
+#include <bench/corpus.hpp>
+
+#include <filesystem>
+#include <vector>
+
+namespace image_processor::bench {
+
+/**
+ * @brief Registers micro-benchmarks for every filter kernel and image conversion.
+ *
+ * One benchmark is registered per kernel and corpus image. Images are decoded before
+ * timing starts, so only the kernel itself is measured. Throughput is reported in pixels
+ * per second through the items_per_second counter.
+ *
+ * @param corpus Images to run the kernels on.
+ */
+void RegisterKernelBenchmarks(const std::vector<CorpusImage>& corpus);
+
+/**
+ * @brief Registers end-to-end benchmarks that go through the public API.
+ *
+ * Each benchmark submits a batch of tasks with SubmitTask and waits until every task has
+ * either a result or an error, so decoding, queueing, filtering and encoding are all part
+ * of the measurement.
+ *
+ * Also registers BM_Placement benchmarks that run the same load with every CPU pinning
+ * and NUMA policy, to compare pinned and unpinned throughput, and BM_ColdIngest
+ * benchmarks that process copies of one image from a cold page cache, submitted one by
+ * one with SubmitTask or ingested in disk order with IngestManifest. BM_OutputSink
+ * benchmarks compare writing a file per result with packing results into shards.
+ *
+ * @param corpus Images to submit.
+ * @param output_root Directory the processed images are written to.
+ */
+void RegisterPipelineBenchmarks(const std::vector<CorpusImage>& corpus,
+                                const std::filesystem::path& output_root);
+
+/**
+ * @brief Registers benchmarks that measure the memory used by one million queued tasks.
+ *
+ * Compares tasks that own a copy of their filters with tasks that share interned filter
+ * chains. Results are reported, as resident set growth, through the rss_mb and
+ * bytes_per_task counters.
+ */
+void RegisterMemoryBenchmarks();
+
+/**
+ * @brief Registers benchmarks that compare the peak memory used to process a 12000x12000
+ * image decoded as a whole with the same image streamed in strips.
+ *
+ * The image is generated in @p corpus_dir when a benchmark first runs. Results are reported, as resident
+ * set growth, through the peak_rss_mb counter.
+ *
+ * @param corpus_dir Directory the benchmark corpus is stored in.
+ */
+void RegisterStreamingBenchmarks(const std::filesystem::path& corpus_dir);
+
+} // namespace image_processor::bench
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace image_processor::bench {
+
+/**
+ * @struct CorpusImage
+ * @brief Describes a single image of the synthetic benchmark corpus.
+ */
+struct CorpusImage {
+  std::string path;   ///< Absolute path to the encoded image on disk.
+  std::string name;   ///< Short label used in benchmark names, e.g. "1280x720/png/color".
+  std::string format; ///< File format, either "jpg" or "png".
+  int width;          ///< Width of the image in pixels.
+  int height;         ///< Height of the image in pixels.
+  bool color;         ///< True for 3-channel BGR images, false for grayscale.
+};
+
+/**
+ * @brief Generates the synthetic benchmark corpus.
+ *
+ * The corpus covers several resolutions, both JPEG and PNG, and both grayscale and color
+ * images. Pixel data is produced from a fixed seed, so every run and every machine gets
+ * byte-identical inputs. Images that already exist in @p root are reused.
+ *
+ * @param root Directory to store the corpus in. Created if it does not exist.
+ * @return Descriptions of all corpus images, ordered by resolution, format and color.
+ */
+std::vector<CorpusImage> GenerateCorpus(const std::filesystem::path& root);
+
+} // namespace image_processor::bench
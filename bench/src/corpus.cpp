@@ -0,0 +1,112 @@
+#include <bench/corpus.hpp>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace image_processor::bench {
+
+namespace {
+
+constexpr std::uint64_t kCorpusSeed = 0x1A2B3C4D;
+constexpr int kShapeCount = 64;
+constexpr int kJpegQuality = 90;
+
+struct Resolution {
+  int width;
+  int height;
+};
+
+constexpr Resolution kResolutions[] = {
+    {320, 240},
+    {1280, 720},
+    {1920, 1080},
+    {3840, 2160},
+};
+
+/**
+ * @brief Renders a deterministic test picture: a gradient, random shapes and noise.
+ *
+ * Flat gradients, hard edges and fine noise give both codecs and filters a workload that
+ * is closer to a photograph than a constant or purely random image would be.
+ */
+cv::Mat RenderImage(int width, int height, bool color) {
+  cv::RNG rng(kCorpusSeed ^ (static_cast<std::uint64_t>(width) << 32) ^
+              (static_cast<std::uint64_t>(height) << 1) ^ (color ? 1 : 0));
+
+  cv::Mat image(height, width, color ? CV_8UC3 : CV_8UC1);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const auto r = static_cast<uchar>(255 * x / width);
+      const auto g = static_cast<uchar>(255 * y / height);
+      if (color) {
+        image.at<cv::Vec3b>(y, x) = cv::Vec3b(static_cast<uchar>((r + g) / 2), g, r);
+      } else {
+        image.at<uchar>(y, x) = static_cast<uchar>((r + g) / 2);
+      }
+    }
+  }
+
+  for (int i = 0; i < kShapeCount; ++i) {
+    const cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+    const int radius = rng.uniform(4, std::max(5, std::min(width, height) / 6));
+    const cv::Scalar shape_color(rng.uniform(0, 256), rng.uniform(0, 256),
+                                 rng.uniform(0, 256));
+    if (i % 2 == 0) {
+      cv::circle(image, center, radius, shape_color, cv::FILLED, cv::LINE_AA);
+    } else {
+      cv::rectangle(image, center, center + cv::Point(radius, radius / 2), shape_color,
+                    cv::FILLED);
+    }
+  }
+
+  cv::Mat noise(image.size(), CV_MAKETYPE(CV_16S, image.channels()));
+  rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(8));
+  cv::add(image, noise, image, cv::noArray(), image.depth());
+
+  return image;
+}
+
+} // namespace
+
+std::vector<CorpusImage> GenerateCorpus(const std::filesystem::path& root) {
+  std::filesystem::create_directories(root);
+
+  std::vector<CorpusImage> corpus;
+  for (const auto& resolution : kResolutions) {
+    for (const std::string format : {"jpg", "png"}) {
+      for (const bool color : {false, true}) {
+        const std::string size =
+            std::to_string(resolution.width) + "x" + std::to_string(resolution.height);
+        const std::string channels = color ? "color" : "gray";
+
+        CorpusImage image;
+        image.path = (root / (size + "_" + channels + "." + format)).string();
+        image.name = size + "/" + format + "/" + channels;
+        image.format = format;
+        image.width = resolution.width;
+        image.height = resolution.height;
+        image.color = color;
+
+        if (!std::filesystem::exists(image.path)) {
+          const std::vector<int> params =
+              format == "jpg" ? std::vector<int>{cv::IMWRITE_JPEG_QUALITY, kJpegQuality}
+                              : std::vector<int>{};
+          const cv::Mat pixels = RenderImage(resolution.width, resolution.height, color);
+          if (!cv::imwrite(image.path, pixels, params)) {
+            throw std::runtime_error("Failed to write corpus image " + image.path);
+          }
+        }
+
+        corpus.push_back(std::move(image));
+      }
+    }
+  }
+
+  return corpus;
+}
+
+} // namespace image_processor::bench
@@ -0,0 +1,151 @@
+#include <bench/benchmarks.hpp>
+
+#include <internal/utils.hpp>
+
+#include <benchmark/benchmark.h>
+#include <opencv2/imgcodecs.hpp>
+
+#include <lib1/filters/blur.h>
+#include <lib2/filters/watercolor.h>
+#include <lib3/filters/cartoonize.h>
+#include <lib5/filters/crop.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace image_processor::bench {
+
+namespace {
+
+using Kernel = std::function<void(const cv::Mat&, cv::Mat&)>;
+
+cv::Mat LoadImage(const CorpusImage& image) {
+  return cv::imread(image.path, image.color ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE);
+}
+
+void RunKernel(benchmark::State& state, const CorpusImage& image, const Kernel& kernel) {
+  const cv::Mat src = LoadImage(image);
+  cv::Mat dst;
+  for (auto _ : state) {
+    kernel(src, dst);
+    benchmark::DoNotOptimize(dst.data);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * src.total());
+  state.SetBytesProcessed(state.iterations() * src.total() * src.elemSize());
+}
+
+void RegisterKernel(const std::string& name, const CorpusImage& image, Kernel kernel) {
+  benchmark::RegisterBenchmark(("BM_Kernel/" + name + "/" + image.name).c_str(),
+                               [image, kernel](benchmark::State& state) {
+                                 RunKernel(state, image, kernel);
+                               })
+      ->Unit(benchmark::kMillisecond);
+}
+
+template <typename Pixel>
+using SiplKernel = std::function<void(const SIPL::Image<Pixel>&)>;
+
+template <typename Pixel>
+using SiplConversion = SIPL::Image<Pixel> (*)(const cv::Mat&);
+
+/**
+ * @brief Registers a kernel that runs on a SIPL image; reported in megapixels/s as well,
+ * since SIPL kernels are the most expensive ones.
+ */
+template <typename Pixel>
+void RegisterSiplKernel(const std::string& name, const CorpusImage& image,
+                        SiplConversion<Pixel> to_sipl, SiplKernel<Pixel> kernel) {
+  benchmark::RegisterBenchmark(
+      ("BM_Kernel/" + name + "/" + image.name).c_str(),
+      [image, to_sipl, kernel](benchmark::State& state) {
+        const SIPL::Image<Pixel> src = to_sipl(LoadImage(image));
+        for (auto _ : state) {
+          kernel(src);
+          benchmark::ClobberMemory();
+        }
+        const auto pixels =
+            static_cast<double>(state.iterations()) * image.width * image.height;
+        state.SetItemsProcessed(static_cast<std::int64_t>(pixels));
+        state.counters["megapixels_per_second"] =
+            benchmark::Counter(pixels / 1e6, benchmark::Counter::kIsRate);
+      })
+      ->Unit(benchmark::kMillisecond);
+}
+
+template <typename Pixel>
+void RegisterSiplKernels(const CorpusImage& image, SiplConversion<Pixel> to_sipl) {
+  RegisterKernel("ConvertToSIPL", image, [to_sipl](const cv::Mat& src, cv::Mat&) {
+    SIPL::Image<Pixel> sipl_image = to_sipl(src);
+    benchmark::DoNotOptimize(&sipl_image);
+  });
+
+  RegisterSiplKernel<Pixel>("ConvertToCV", image, to_sipl,
+                            [](const SIPL::Image<Pixel>& src) {
+                              cv::Mat dst = utils::ConvertToCV(src);
+                              benchmark::DoNotOptimize(dst.data);
+                            });
+
+  // The detalization level sets the number of smoothing iterations, from 8 down to 2.
+  for (const int level : {0, 50, 100}) {
+    RegisterSiplKernel<Pixel>("Cartoonize/detail_" + std::to_string(level), image, to_sipl,
+                              [level](const SIPL::Image<Pixel>& src) {
+                                SIPL::Image<Pixel> cartoonized =
+                                    lib3::cartoonize(src, level / 100.0f);
+                                benchmark::DoNotOptimize(&cartoonized);
+                              });
+  }
+}
+
+} // namespace
+
+void RegisterKernelBenchmarks(const std::vector<CorpusImage>& corpus) {
+  for (const auto& image : corpus) {
+    benchmark::RegisterBenchmark(("BM_Decode/" + image.name).c_str(),
+                                 [image](benchmark::State& state) {
+                                   for (auto _ : state) {
+                                     benchmark::DoNotOptimize(LoadImage(image).data);
+                                   }
+                                   state.SetItemsProcessed(state.iterations() *
+                                                           image.width * image.height);
+                                 })
+        ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(("BM_Encode/" + image.name).c_str(),
+                                 [image](benchmark::State& state) {
+                                   const cv::Mat src = LoadImage(image);
+                                   std::vector<uchar> buffer;
+                                   for (auto _ : state) {
+                                     cv::imencode("." + image.format, src, buffer);
+                                     benchmark::DoNotOptimize(buffer.data());
+                                   }
+                                   state.SetItemsProcessed(state.iterations() * src.total());
+                                 })
+        ->Unit(benchmark::kMillisecond);
+
+    RegisterKernel("Crop", image, [](const cv::Mat& src, cv::Mat& dst) {
+      lib5::crop(src, dst, cv::Rect(src.cols / 4, src.rows / 4, src.cols / 2, src.rows / 2));
+    });
+
+    RegisterKernel("Blur", image, [](const cv::Mat& src, cv::Mat& dst) {
+      lib1::blur(src, dst, cv::Size(5, 5));
+    });
+
+    // The kernel grows with the square of the brush size, from 3x3 up to 31x31.
+    for (const int brush_size : {0, 25, 50, 100}) {
+      RegisterKernel("Watercolor/brush_" + std::to_string(brush_size), image,
+                     [brush_size](const cv::Mat& src, cv::Mat& dst) {
+                       lib2::watercolor(src, dst, brush_size / 100.0f, 0.5f, 0.5f);
+                     });
+    }
+
+    if (image.color) {
+      RegisterSiplKernels<SIPL::color_float>(image, utils::ConvertToSIPLColor);
+    } else {
+      RegisterSiplKernels<float>(image, utils::ConvertToSIPL);
+    }
+  }
+}
+
+} // namespace image_processor::bench
@@ -0,0 +1,448 @@
+#include <bench/corpus.hpp>
+
+#include <image_processor/api.hpp>
+#include <image_processor/filter_factory.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace image_processor::bench {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @struct LoadOptions
+ * @brief Command line configuration of a load generator run.
+ */
+struct LoadOptions {
+  bool open_loop = true;            ///< Submit at a fixed rate instead of a fixed concurrency.
+  double rate = 100.0;              ///< Tasks per second submitted in open-loop mode.
+  std::size_t concurrency = 64;     ///< Tasks kept in flight in closed-loop mode.
+  double duration_s = 60.0;         ///< Total length of the run.
+  double warmup_s = 10.0;           ///< Time excluded from limit checks and baselines.
+  double report_interval_s = 10.0;  ///< Length of one reporting interval.
+  double max_p99_growth_ms = 0.0;   ///< p99 growth limit over baseline, 0 disables it.
+  double max_rss_growth_mb = 0.0;   ///< RSS growth limit over the baseline, 0 disables it.
+  std::string corpus_dir;           ///< Where the synthetic corpus is generated.
+  std::string output;               ///< File for JSON reports, stdout if empty.
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief Fixed-size log-linear histogram of latencies in microseconds.
+ *
+ * Each power of two is split into kSubBuckets linear buckets, which bounds the relative
+ * error of a reported percentile to 1/kSubBuckets while keeping memory constant no matter
+ * how long the soak runs.
+ */
+class LatencyHistogram {
+public:
+  void Record(std::uint64_t micros) {
+    ++counts_[BucketOf(micros)];
+    ++total_;
+    max_ = std::max(max_, micros);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  void Reset() { *this = LatencyHistogram(); }
+
+  std::uint64_t Count() const { return total_; }
+
+  double PercentileMs(double percentile) const {
+    if (total_ == 0) {
+      return 0.0;
+    }
+
+    const auto rank =
+        static_cast<std::uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total_)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return static_cast<double>(std::min(UpperBoundOf(i), max_)) / 1000.0;
+      }
+    }
+    return static_cast<double>(max_) / 1000.0;
+  }
+
+  double MaxMs() const { return static_cast<double>(max_) / 1000.0; }
+
+private:
+  static constexpr std::size_t kSubBucketBits = 4;
+  static constexpr std::size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr std::size_t kMagnitudes = 40;
+
+  static std::size_t BucketOf(std::uint64_t value) {
+    if (value < kSubBuckets) {
+      return static_cast<std::size_t>(value);
+    }
+    const std::size_t magnitude = 63 - static_cast<std::size_t>(__builtin_clzll(value));
+    const std::size_t shift = magnitude - kSubBucketBits;
+    const std::size_t sub = static_cast<std::size_t>(value >> shift) & (kSubBuckets - 1);
+    return std::min((shift + 1) * kSubBuckets + sub, kSubBuckets * kMagnitudes - 1);
+  }
+
+  static std::uint64_t UpperBoundOf(std::size_t bucket) {
+    if (bucket < kSubBuckets) {
+      return bucket;
+    }
+    const std::size_t shift = bucket / kSubBuckets - 1;
+    const std::uint64_t sub = bucket % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+  }
+
+  std::array<std::uint64_t, kSubBuckets * kMagnitudes> counts_{};
+  std::uint64_t total_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+/**
+ * @brief Returns the resident set size of this process in megabytes.
+ */
+double ResidentSetMb() {
+  std::ifstream statm("/proc/self/statm");
+  std::uint64_t size_pages = 0;
+  std::uint64_t resident_pages = 0;
+  statm >> size_pages >> resident_pages;
+  return static_cast<double>(resident_pages) * static_cast<double>(sysconf(_SC_PAGESIZE)) /
+         (1024.0 * 1024.0);
+}
+
+struct PendingTask {
+  std::string id;
+  Clock::time_point scheduled;
+};
+
+/**
+ * @class LoadGenerator
+ * @brief Drives the public API with a configured load and tracks every task to completion.
+ *
+ * A submitter thread issues tasks and a collector thread polls the outstanding ones. In
+ * open-loop mode latency is measured from the time a task was scheduled to be submitted,
+ * not from when it actually was, so a stalled submitter cannot hide queueing delay.
+ * Failed tasks are counted on their own and left out of the latency percentiles.
+ *
+ * Limits are checked against baselines taken at the first interval after the warmup: the
+ * RSS at that point and the p99 latency of that interval.
+ */
+class LoadGenerator {
+public:
+  LoadGenerator(const LoadOptions& options, std::vector<CorpusImage> corpus)
+      : options_(options), corpus_(std::move(corpus)) {}
+
+  /**
+   * @brief Runs the load for the configured duration and reports every interval.
+   *
+   * @return true if no configured limit was exceeded.
+   */
+  bool Run(std::ostream& out) {
+    start_ = Clock::now();
+    std::thread submitter(&LoadGenerator::Submit, this);
+    std::thread collector(&LoadGenerator::Collect, this);
+
+    bool passed = true;
+    double baseline_rss_mb = 0.0;
+    double baseline_p99_ms = 0.0;
+    bool has_baseline_p99 = false;
+    std::uint64_t last_completed = 0;
+    auto next_report = start_;
+    while (!done_.load()) {
+      next_report += ToDuration(options_.report_interval_s);
+      std::this_thread::sleep_until(next_report);
+
+      const double elapsed_s = SecondsSince(start_);
+      if (elapsed_s >= options_.duration_s) {
+        done_.store(true);
+      }
+
+      LatencyHistogram interval;
+      {
+        std::lock_guard<std::mutex> lock(histogram_mutex_);
+        interval = interval_histogram_;
+        total_histogram_.Merge(interval_histogram_);
+        interval_histogram_.Reset();
+      }
+
+      const std::uint64_t completed = completed_.load();
+      const double rss_mb = ResidentSetMb();
+      const bool warm = elapsed_s >= options_.warmup_s;
+      if (warm && baseline_rss_mb == 0.0) {
+        baseline_rss_mb = rss_mb;
+      }
+      const double p99_ms = interval.PercentileMs(99);
+      if (warm && !has_baseline_p99 && interval.Count() > 0) {
+        baseline_p99_ms = p99_ms;
+        has_baseline_p99 = true;
+      }
+
+      // An interval in which nothing completed has no p99 to compare.
+      const double p99_growth_ms =
+          has_baseline_p99 && interval.Count() > 0 ? p99_ms - baseline_p99_ms : 0.0;
+      const bool latency_exceeded =
+          options_.max_p99_growth_ms > 0.0 && p99_growth_ms > options_.max_p99_growth_ms;
+      const bool rss_exceeded = warm && options_.max_rss_growth_mb > 0.0 &&
+                                rss_mb - baseline_rss_mb > options_.max_rss_growth_mb;
+      passed = passed && !latency_exceeded && !rss_exceeded;
+
+      out << "{\"type\":\"interval\",\"elapsed_s\":" << elapsed_s
+          << ",\"submitted\":" << submitted_.load() << ",\"completed\":" << completed
+          << ",\"failed\":" << failed_.load() << ",\"outstanding\":" << Outstanding()
+          << ",\"throughput\":"
+          << static_cast<double>(completed - last_completed) / options_.report_interval_s
+          << ",\"p50_ms\":" << interval.PercentileMs(50)
+          << ",\"p90_ms\":" << interval.PercentileMs(90)
+          << ",\"p99_ms\":" << p99_ms << ",\"p99_growth_ms\":" << p99_growth_ms
+          << ",\"p999_ms\":" << interval.PercentileMs(99.9)
+          << ",\"max_ms\":" << interval.MaxMs() << ",\"rss_mb\":" << rss_mb
+          << ",\"rss_growth_mb\":" << (warm ? rss_mb - baseline_rss_mb : 0.0)
+          << ",\"latency_exceeded\":" << std::boolalpha << latency_exceeded
+          << ",\"rss_exceeded\":" << rss_exceeded << "}" << std::endl;
+      last_completed = completed;
+
+      if (!passed) {
+        done_.store(true);
+      }
+    }
+
+    submitter.join();
+    collector.join();
+
+    out << "{\"type\":\"summary\",\"passed\":" << std::boolalpha << passed
+        << ",\"elapsed_s\":" << SecondsSince(start_) << ",\"submitted\":" << submitted_.load()
+        << ",\"completed\":" << completed_.load() << ",\"failed\":" << failed_.load()
+        << ",\"abandoned\":" << Outstanding()
+        << ",\"p50_ms\":" << total_histogram_.PercentileMs(50)
+        << ",\"p99_ms\":" << total_histogram_.PercentileMs(99)
+        << ",\"p999_ms\":" << total_histogram_.PercentileMs(99.9)
+        << ",\"max_ms\":" << total_histogram_.MaxMs() << "}" << std::endl;
+    return passed;
+  }
+
+private:
+  static Clock::duration ToDuration(double seconds) {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+  }
+
+  static double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  std::vector<Filter> OperationsFor(const CorpusImage& image) const {
+    // Resize is left out while lib4::resize is a stub.
+    const auto width = static_cast<std::uint16_t>(image.width / 2);
+    const auto height = static_cast<std::uint16_t>(image.height / 2);
+    return {filter_factory::CreateCropFilter(0, 0, width, height),
+            filter_factory::CreateBlurFilter(3)};
+  }
+
+  std::size_t Outstanding() {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return pending_.size() + collecting_.load();
+  }
+
+  void Submit() {
+    std::uint64_t sequence = 0;
+    while (!done_.load()) {
+      Clock::time_point scheduled = Clock::now();
+      if (options_.open_loop) {
+        scheduled = start_ + ToDuration(static_cast<double>(sequence) / options_.rate);
+        std::this_thread::sleep_until(scheduled);
+      } else if (Outstanding() >= options_.concurrency) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      const CorpusImage& image = corpus_[sequence % corpus_.size()];
+      std::string id = SubmitTask(image.path, OperationsFor(image));
+      {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_.push_back({std::move(id), scheduled});
+      }
+      submitted_.fetch_add(1);
+      ++sequence;
+    }
+  }
+
+  void Collect() {
+    std::vector<PendingTask> sweep;
+    std::vector<PendingTask> still_pending;
+    while (!done_.load()) {
+      {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        sweep.swap(pending_);
+        collecting_.store(sweep.size());
+      }
+
+      LatencyHistogram sweep_histogram;
+      for (auto& task : sweep) {
+        if (!IsTaskComplete(task.id)) {
+          if (GetError(task.id) != ImageProcessingError::kNoError) {
+            failed_.fetch_add(1);
+          } else {
+            still_pending.push_back(std::move(task));
+          }
+          continue;
+        }
+
+        std::remove(GetResult(task.id).c_str());
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - task.scheduled);
+        sweep_histogram.Record(static_cast<std::uint64_t>(latency.count()));
+        completed_.fetch_add(1);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(histogram_mutex_);
+        interval_histogram_.Merge(sweep_histogram);
+      }
+      {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_.insert(pending_.end(), std::make_move_iterator(still_pending.begin()),
+                        std::make_move_iterator(still_pending.end()));
+        collecting_.store(0);
+      }
+
+      sweep.clear();
+      still_pending.clear();
+      std::this_thread::yield();
+    }
+  }
+
+  const LoadOptions options_;
+  const std::vector<CorpusImage> corpus_;
+  Clock::time_point start_;
+
+  std::atomic<bool> done_{false};
+  std::atomic<std::uint64_t> submitted_{0};
+  std::atomic<std::uint64_t> completed_{0};
+  std::atomic<std::uint64_t> failed_{0};
+  std::atomic<std::size_t> collecting_{0};
+
+  std::mutex pending_mutex_;
+  std::vector<PendingTask> pending_;
+
+  std::mutex histogram_mutex_;
+  LatencyHistogram interval_histogram_;
+  LatencyHistogram total_histogram_;
+};
+
+LoadOptions ParseOptions(int argc, char** argv) {
+  LoadOptions options;
+  options.corpus_dir =
+      (std::filesystem::temp_directory_path() / "image_processor_bench_corpus").string();
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const auto separator = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || separator == std::string::npos) {
+      throw std::invalid_argument("Unrecognized argument: " + arg);
+    }
+
+    const std::string name = arg.substr(2, separator - 2);
+    const std::string value = arg.substr(separator + 1);
+    if (name == "mode") {
+      if (value != "open" && value != "closed") {
+        throw std::invalid_argument("--mode must be 'open' or 'closed'");
+      }
+      options.open_loop = value == "open";
+    } else if (name == "rate") {
+      options.rate = std::stod(value);
+    } else if (name == "concurrency") {
+      options.concurrency = std::stoul(value);
+    } else if (name == "duration") {
+      options.duration_s = std::stod(value);
+    } else if (name == "warmup") {
+      options.warmup_s = std::stod(value);
+    } else if (name == "report_interval") {
+      options.report_interval_s = std::stod(value);
+    } else if (name == "max_p99_growth_ms") {
+      options.max_p99_growth_ms = std::stod(value);
+    } else if (name == "max_rss_growth_mb") {
+      options.max_rss_growth_mb = std::stod(value);
+    } else if (name == "corpus_dir") {
+      options.corpus_dir = value;
+    } else if (name == "output") {
+      options.output = value;
+    } else {
+      throw std::invalid_argument("Unrecognized argument: " + arg);
+    }
+  }
+
+  if (options.rate <= 0.0 || options.concurrency == 0 || options.report_interval_s <= 0.0) {
+    throw std::invalid_argument("--rate, --concurrency and --report_interval must be positive");
+  }
+
+  return options;
+}
+
+} // namespace
+
+} // namespace image_processor::bench
+
+/**
+ * Runs a load generator / soak test against the public API.
+ *
+ * Flags (all --name=value):
+ *   mode               "open" (fixed submit rate) or "closed" (fixed concurrency).
+ *   rate               Tasks per second in open-loop mode.
+ *   concurrency        Tasks in flight in closed-loop mode.
+ *   duration           Length of the run in seconds; multi-hour soaks are expected.
+ *   warmup             Seconds before limits are enforced and the baselines are taken.
+ *   report_interval    Seconds between JSON reports.
+ *   max_p99_growth_ms  Fail if an interval's p99 latency grows by more than this over
+ *                      the p99 of the first interval after the warmup.
+ *   max_rss_growth_mb  Fail if RSS grows by more than this over the baseline.
+ *   corpus_dir         Where the synthetic corpus is generated.
+ *   output             File for JSON-lines reports (stdout by default).
+ *
+ * Exits with status 1 as soon as a limit is exceeded, 2 on invalid arguments.
+ */
+int main(int argc, char** argv) {
+  using namespace image_processor::bench;
+
+  LoadOptions options;
+  try {
+    options = ParseOptions(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+
+  std::ofstream file;
+  if (!options.output.empty()) {
+    file.open(options.output);
+  }
+  std::ostream& out = options.output.empty() ? std::cout : file;
+
+  image_processor::Initialize();
+  LoadGenerator generator(options, GenerateCorpus(options.corpus_dir));
+  const bool passed = generator.Run(out);
+  image_processor::Shutdown();
+
+  return passed ? 0 : 1;
+}
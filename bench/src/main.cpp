@@ -0,0 +1,67 @@
+#include <bench/benchmarks.hpp>
+#include <bench/corpus.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr const char* kCorpusDirFlag = "--corpus_dir=";
+
+bool HasFlag(int argc, char** argv, const char* prefix) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], prefix, std::strlen(prefix)) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+/**
+ * Runs the benchmark suite.
+ *
+ * Besides the usual Google Benchmark flags, accepts --corpus_dir=<path> to choose where
+ * the synthetic corpus is generated (defaults to a directory under the system temporary
+ * directory). Results are printed as JSON unless --benchmark_format is given, so runs on
+ * different commits can be compared with Google Benchmark's compare.py.
+ */
+int main(int argc, char** argv) {
+  std::filesystem::path corpus_dir =
+      std::filesystem::temp_directory_path() / "image_processor_bench_corpus";
+
+  std::vector<char*> args;
+  std::string json_format = "--benchmark_format=json";
+  for (int i = 0; i < argc; ++i) {
+    if (std::strncmp(argv[i], kCorpusDirFlag, std::strlen(kCorpusDirFlag)) == 0) {
+      corpus_dir = argv[i] + std::strlen(kCorpusDirFlag);
+      continue;
+    }
+    args.push_back(argv[i]);
+  }
+  if (!HasFlag(argc, argv, "--benchmark_format=")) {
+    args.push_back(json_format.data());
+  }
+
+  int args_count = static_cast<int>(args.size());
+  benchmark::Initialize(&args_count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(args_count, args.data())) {
+    return 1;
+  }
+
+  const auto corpus = image_processor::bench::GenerateCorpus(corpus_dir);
+  image_processor::bench::RegisterKernelBenchmarks(corpus);
+  image_processor::bench::RegisterMemoryBenchmarks();
+  image_processor::bench::RegisterStreamingBenchmarks(corpus_dir);
+  image_processor::bench::RegisterPipelineBenchmarks(
+      corpus, std::filesystem::temp_directory_path() / "image_processor_bench_output");
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,214 @@
+#include <bench/benchmarks.hpp>
+
+#include <image_processor/filter_factory.hpp>
+#include <internal/image_processor.hpp>
+#include <internal/strip_codec.hpp>
+#include <internal/task_queue.hpp>
+
+#include <benchmark/benchmark.h>
+#include <malloc.h>
+#include <opencv2/core.hpp>
+#include <tbb/concurrent_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace image_processor::bench {
+
+namespace {
+
+constexpr std::size_t kQueuedTasks = 1'000'000;
+
+/**
+ * @brief Task layout before chains were interned: every task owns a copy of its filters.
+ */
+struct LegacyTask {
+  std::string id;
+  std::string image;
+  std::vector<Filter> operations;
+};
+
+std::vector<std::vector<Filter>> DistinctChains() {
+  return {
+      {filter_factory::CreateResizeFilter(640, 480), filter_factory::CreateBlurFilter(3)},
+      {filter_factory::CreateCropFilter(0, 0, 800, 600)},
+      {filter_factory::CreateWatercolorFilter(0.5f, 0.5f, 0.5f),
+       filter_factory::CreateCartoonizeFilter(0.5f)},
+      {filter_factory::CreateResizeFilter(1280, 720),
+       filter_factory::CreateCropFilter(0, 0, 1000, 700), filter_factory::CreateBlurFilter(5)},
+  };
+}
+
+std::string TaskId(std::size_t index) {
+  // Same length as the UUIDs SubmitTask generates.
+  std::string id = std::to_string(index);
+  id.insert(0, 36 - id.size(), '0');
+  return id;
+}
+
+/**
+ * @brief Resident set size of the process. Unlike mallinfo2(), it also sees memory that
+ * does not come from glibc malloc, such as the storage tbbmalloc serves to
+ * tbb::concurrent_queue.
+ */
+std::size_t ResidentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  std::size_t total_pages = 0;
+  std::size_t resident_pages = 0;
+  statm >> total_pages >> resident_pages;
+  return resident_pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+template <typename Fill>
+void MeasureQueuedTasks(benchmark::State& state, Fill fill) {
+  for (auto _ : state) {
+    malloc_trim(0);
+    const std::size_t before = ResidentBytes();
+    const auto queue = fill();
+    const std::size_t after = ResidentBytes();
+    benchmark::DoNotOptimize(queue.get());
+
+    state.counters["rss_mb"] = static_cast<double>(after - before) / (1024.0 * 1024.0);
+    state.counters["bytes_per_task"] =
+        static_cast<double>(after - before) / static_cast<double>(kQueuedTasks);
+  }
+}
+
+void BM_QueuedTasksMemory_CopiedFilters(benchmark::State& state) {
+  const auto chains = DistinctChains();
+  MeasureQueuedTasks(state, [&chains] {
+    auto queue = std::make_unique<tbb::concurrent_queue<LegacyTask>>();
+    for (std::size_t i = 0; i < kQueuedTasks; ++i) {
+      queue->push({TaskId(i), "/data/images/input.jpg", chains[i % chains.size()]});
+    }
+    return queue;
+  });
+}
+
+void BM_QueuedTasksMemory_InternedChains(benchmark::State& state) {
+  const auto chains = DistinctChains();
+  MeasureQueuedTasks(state, [&chains] {
+    auto queue = std::make_unique<TaskQueue>();
+    for (std::size_t i = 0; i < kQueuedTasks; ++i) {
+      queue->Push({TaskId(i), "/data/images/input.jpg",
+                   FilterChain::Intern(chains[i % chains.size()])});
+    }
+    return queue;
+  });
+}
+
+/**
+ * @brief Side of the square image the streaming benchmarks process: 144 megapixels, above
+ * the default streaming threshold.
+ */
+constexpr int kLargeImageSide = 12'000;
+
+/**
+ * @brief Writes a smooth gradient as a JPEG unless it exists already, strip by strip so
+ * that generating it does not need the whole image in memory either.
+ */
+void GenerateLargeImage(const std::filesystem::path& path) {
+  if (std::filesystem::exists(path)) {
+    return;
+  }
+  std::filesystem::create_directories(path.parent_path());
+
+  auto encoder = StripEncoder::Create(path.string(), kLargeImageSide, kLargeImageSide);
+  cv::Mat rows(64, kLargeImageSide, CV_8UC3);
+  for (int y = 0; encoder && y < kLargeImageSide; y += rows.rows) {
+    for (int r = 0; r < rows.rows; ++r) {
+      auto* pixel = rows.ptr<cv::Vec3b>(r);
+      for (int x = 0; x < kLargeImageSide; ++x) {
+        pixel[x] = cv::Vec3b(static_cast<uchar>(x), static_cast<uchar>(y + r),
+                             static_cast<uchar>((x + y + r) / 64));
+      }
+    }
+    encoder->WriteRows(rows);
+  }
+  if (encoder) {
+    encoder->Finish();
+  }
+}
+
+/**
+ * @brief Processes the large image with a Crop and Blur chain and reports the peak
+ * resident set growth, sampled every millisecond, through the peak_rss_mb counter.
+ *
+ * The image is generated on first use, so runs that filter this benchmark out do not pay
+ * for it.
+ */
+void MeasureLargeImage(benchmark::State& state, const std::filesystem::path& image,
+                       std::uint64_t streaming_threshold) {
+  GenerateLargeImage(image);
+  const auto output_root =
+      std::filesystem::temp_directory_path() / "image_processor_bench_streaming";
+  const std::string output_dir = output_root.string();
+  std::filesystem::create_directories(output_dir);
+  const auto chain = FilterChain::Intern({
+      filter_factory::CreateCropFilter(0, 0, 11'000, 11'000),
+      filter_factory::CreateBlurFilter(5),
+  });
+
+  for (auto _ : state) {
+    malloc_trim(0);
+    const std::size_t before = ResidentBytes();
+    std::atomic<bool> done = false;
+    std::size_t peak = before;
+    std::thread sampler([&] {
+      while (!done.load(std::memory_order_relaxed)) {
+        peak = std::max(peak, ResidentBytes());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+
+    ImageProcessor processor(image.string(), *chain, output_dir, streaming_threshold);
+    const auto error = processor.ProcessImage();
+    done = true;
+    sampler.join();
+    if (error != ImageProcessingError::kNoError) {
+      state.SkipWithError("processing the large image failed");
+      break;
+    }
+
+    state.counters["peak_rss_mb"] =
+        static_cast<double>(peak - before) / (1024.0 * 1024.0);
+  }
+  std::filesystem::remove_all(output_dir);
+}
+
+} // namespace
+
+void RegisterStreamingBenchmarks(const std::filesystem::path& corpus_dir) {
+  const auto image = corpus_dir / "12000x12000.jpg";
+
+  // A threshold of 0 disables streaming, 1 streams every image.
+  benchmark::RegisterBenchmark("BM_LargeImagePeakRss/full_frame",
+                               [image](benchmark::State& state) {
+                                 MeasureLargeImage(state, image, 0);
+                               })
+      ->Iterations(1)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_LargeImagePeakRss/streamed",
+                               [image](benchmark::State& state) {
+                                 MeasureLargeImage(state, image, 1);
+                               })
+      ->Iterations(1)
+      ->Unit(benchmark::kMillisecond);
+}
+
+void RegisterMemoryBenchmarks() {
+  benchmark::RegisterBenchmark("BM_QueuedTasksMemory/copied_filters",
+                               BM_QueuedTasksMemory_CopiedFilters)
+      ->Iterations(1)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_QueuedTasksMemory/interned_chains",
+                               BM_QueuedTasksMemory_InternedChains)
+      ->Iterations(1)
+      ->Unit(benchmark::kMillisecond);
+}
+
+} // namespace image_processor::bench
@@ -0,0 +1,333 @@
+#include <bench/benchmarks.hpp>
+
+#include <image_processor/api.hpp>
+#include <image_processor/filter_factory.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+namespace image_processor::bench {
+
+namespace {
+
+constexpr int kBatchSizes[] = {16, 256};
+
+struct Chain {
+  const char* name;
+  std::vector<Filter> (*make)(const CorpusImage& image);
+};
+
+// Resize is left out while lib4::resize is a stub, so every chain runs real kernels.
+const Chain kChains[] = {
+    {"blur",
+     [](const CorpusImage&) {
+       return std::vector<Filter>{filter_factory::CreateBlurFilter(5)};
+     }},
+    {"crop",
+     [](const CorpusImage& image) {
+       return std::vector<Filter>{filter_factory::CreateCropFilter(
+           0, 0, static_cast<std::uint16_t>(image.width / 2),
+           static_cast<std::uint16_t>(image.height / 2))};
+     }},
+    {"watercolor_cartoonize",
+     [](const CorpusImage&) {
+       return std::vector<Filter>{filter_factory::CreateWatercolorFilter(0.5f, 0.5f, 0.5f),
+                                  filter_factory::CreateCartoonizeFilter(0.5f)};
+     }},
+};
+
+struct Placement {
+  const char* name;
+  Options::CpuAffinity affinity;
+  Options::NumaMode numa_mode;
+};
+
+const Placement kPlacements[] = {
+    {"unpinned", Options::CpuAffinity::kNone, Options::NumaMode::kDisabled},
+    {"compact", Options::CpuAffinity::kCompact, Options::NumaMode::kDisabled},
+    {"scatter", Options::CpuAffinity::kScatter, Options::NumaMode::kDisabled},
+    {"numa_unpinned", Options::CpuAffinity::kNone, Options::NumaMode::kNodeLocal},
+    {"numa_scatter", Options::CpuAffinity::kScatter, Options::NumaMode::kNodeLocal},
+};
+
+struct Execution {
+  const char* name;
+  Options::ExecutionMode mode;
+};
+
+const Execution kExecutions[] = {
+    {"in_process", Options::ExecutionMode::kInProcess},
+    {"out_of_process", Options::ExecutionMode::kOutOfProcess},
+};
+
+const Options::OutputSink kOutputSinks[] = {Options::OutputSink::kFiles,
+                                             Options::OutputSink::kShards};
+
+/**
+ * @brief Waits until the task has a result or an error and cleans up its output.
+ *
+ * @param remove_result False for results in shards, which hold other results too.
+ * @return true if the task produced a result, false if it failed.
+ */
+bool WaitForTask(const std::string& task_id, bool remove_result = true) {
+  while (true) {
+    if (IsTaskComplete(task_id)) {
+      // Unlike GetResult(), also collects results in shards.
+      const ResultLocator result = GetResultLocator(task_id);
+      if (remove_result) {
+        std::error_code ignored;
+        std::filesystem::remove(result.file, ignored);
+      }
+      return true;
+    }
+
+    if (GetError(task_id) != ImageProcessingError::kNoError) {
+      return false;
+    }
+
+    std::this_thread::yield();
+  }
+}
+
+void RunPipeline(benchmark::State& state, const CorpusImage& image,
+                 const std::vector<Filter>& operations, const Options& options) {
+  const auto batch_size = static_cast<std::size_t>(state.range(0));
+  const bool shards = options.output_sink == Options::OutputSink::kShards;
+  std::vector<std::string> task_ids(batch_size);
+  std::int64_t failed = 0;
+
+  const Pipeline pipeline = CompilePipeline(operations);
+  Initialize(options);
+  for (auto _ : state) {
+    for (auto& task_id : task_ids) {
+      task_id = SubmitTask(image.path, pipeline);
+    }
+    for (const auto& task_id : task_ids) {
+      failed += WaitForTask(task_id, !shards) ? 0 : 1;
+    }
+  }
+  Shutdown();
+
+  if (shards) {
+    std::error_code ignored;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(options.output_directory, ignored)) {
+      if (entry.path().filename().string().rfind("shard-", 0) == 0) {
+        std::filesystem::remove(entry.path(), ignored);
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch_size);
+  state.counters["failed"] = static_cast<double>(failed);
+  state.counters["pixels_per_second"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * batch_size) * image.width * image.height,
+      benchmark::Counter::kIsRate);
+}
+
+/**
+ * @brief Number of copies of one image that the cold-cache benchmarks process.
+ */
+constexpr std::size_t kColdCopies = 512;
+
+/**
+ * @brief Copies an image kColdCopies times and lists the copies in a manifest, shuffled
+ * with a fixed seed: a backfill list rarely follows the order files were written in.
+ *
+ * @return The paths of the copies, in manifest order.
+ */
+std::vector<std::string> PrepareColdCorpus(const CorpusImage& image,
+                                           const std::filesystem::path& manifest) {
+  const auto directory = manifest.parent_path() / "images";
+  std::filesystem::create_directories(directory);
+
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < kColdCopies; ++i) {
+    const auto copy = directory / (std::to_string(i) + "." + image.format);
+    std::filesystem::copy_file(image.path, copy,
+                               std::filesystem::copy_options::skip_existing);
+    paths.push_back(copy.string());
+  }
+  std::shuffle(paths.begin(), paths.end(), std::mt19937(42));
+
+  std::ofstream out(manifest);
+  for (const auto& path : paths) {
+    out << path << '\n';
+  }
+  return paths;
+}
+
+/**
+ * @brief Drops files from the page cache, so the next reads come from the device.
+ *
+ * Works without root, unlike writing to /proc/sys/vm/drop_caches; the files are synced
+ * first because dirty pages cannot be dropped.
+ */
+void EvictFromPageCache(const std::vector<std::string>& paths) {
+  for (const auto& path : paths) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      fdatasync(fd);
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+}
+
+/**
+ * @brief Processes every image of the manifest from a cold page cache, either submitted
+ * one by one in manifest order or ingested in disk order with prefetching.
+ */
+void RunColdIngest(benchmark::State& state, const CorpusImage& image,
+                   const std::vector<Filter>& operations, const Options& options,
+                   bool ingest) {
+  const auto manifest = std::filesystem::temp_directory_path() /
+                        "image_processor_bench_cold" / "manifest.txt";
+  const auto paths = PrepareColdCorpus(image, manifest);
+  std::int64_t failed = 0;
+
+  const Pipeline pipeline = CompilePipeline(operations);
+  Initialize(options);
+  for (auto _ : state) {
+    state.PauseTiming();
+    EvictFromPageCache(paths);
+    state.ResumeTiming();
+
+    std::vector<std::string> task_ids;
+    if (ingest) {
+      for (const auto& task : IngestManifest(manifest.string(), pipeline)) {
+        task_ids.push_back(task.task_id);
+      }
+    } else {
+      for (const auto& path : paths) {
+        task_ids.push_back(SubmitTask(path, pipeline));
+      }
+    }
+    for (const auto& task_id : task_ids) {
+      failed += WaitForTask(task_id) ? 0 : 1;
+    }
+  }
+  Shutdown();
+
+  state.SetItemsProcessed(state.iterations() * kColdCopies);
+  state.counters["failed"] = static_cast<double>(failed);
+}
+
+} // namespace
+
+void RegisterPipelineBenchmarks(const std::vector<CorpusImage>& corpus,
+                                const std::filesystem::path& output_root) {
+  Options options;
+  options.output_directory = output_root.string();
+
+  for (const auto& image : corpus) {
+    for (const auto& chain : kChains) {
+      auto* registration = benchmark::RegisterBenchmark(
+          ("BM_EndToEnd/" + std::string(chain.name) + "/" + image.name).c_str(),
+          [image, operations = chain.make(image), options](benchmark::State& state) {
+            RunPipeline(state, image, operations, options);
+          });
+      for (const int batch_size : kBatchSizes) {
+        registration->Arg(batch_size);
+      }
+      registration->Unit(benchmark::kMillisecond)->UseRealTime();
+    }
+  }
+
+  // The same load under every pinning and NUMA policy, to compare pinned with unpinned.
+  const auto image = std::find_if(corpus.begin(), corpus.end(), [](const auto& candidate) {
+    return candidate.color && candidate.width == 1920 && candidate.format == "jpg";
+  });
+  if (image == corpus.end()) {
+    return;
+  }
+
+  // Watercolor and Cartoonize start parallel loops of their own, which pinning must not
+  // squeeze onto the worker's CPU.
+  for (const auto& [name, affinity, numa_mode] : kPlacements) {
+    Options placement_options = options;
+    placement_options.cpu_affinity = affinity;
+    placement_options.numa_mode = numa_mode;
+    for (const auto* chain : {&kChains[0], &kChains[2]}) {
+      benchmark::RegisterBenchmark(("BM_Placement/" + std::string(name) + "/" +
+                                    chain->name + "/" + image->name)
+                                       .c_str(),
+                                   [image = *image, operations = chain->make(*image),
+                                    placement_options](benchmark::State& state) {
+                                     RunPipeline(state, image, operations,
+                                                 placement_options);
+                                   })
+          ->Arg(kBatchSizes[1])
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+    }
+  }
+
+  // The same images read from a cold page cache, submitted in manifest order or ingested
+  // in disk order with prefetching. Crop keeps the filters cheap so that I/O dominates.
+  for (const bool ingest : {false, true}) {
+    const std::string mode = ingest ? "ingest_manifest" : "submit_task";
+    benchmark::RegisterBenchmark(
+        ("BM_ColdIngest/" + mode + "/" + image->name).c_str(),
+        [image = *image, operations = kChains[1].make(*image), options,
+         ingest](benchmark::State& state) {
+          RunColdIngest(state, image, operations, options, ingest);
+        })
+        ->Iterations(3)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+  }
+
+  // Every chain in worker threads and in worker processes, to measure the overhead of the
+  // process boundary. The smallest image is where that overhead weighs the most.
+  const auto smallest = std::min_element(
+      corpus.begin(), corpus.end(), [](const auto& left, const auto& right) {
+        return left.width * left.height < right.width * right.height;
+      });
+  for (const auto& execution_image : {*smallest, *image}) {
+    for (const auto& chain : kChains) {
+      for (const auto& [name, mode] : kExecutions) {
+        Options execution_options = options;
+        execution_options.execution_mode = mode;
+        execution_options.worker_executable = IMAGE_PROCESSOR_WORKER_PATH;
+        benchmark::RegisterBenchmark(
+            ("BM_ExecutionMode/" + std::string(name) + "/" + chain.name + "/" +
+             execution_image.name)
+                .c_str(),
+            [execution_image, operations = chain.make(execution_image),
+             execution_options](benchmark::State& state) {
+              RunPipeline(state, execution_image, operations, execution_options);
+            })
+            ->Arg(kBatchSizes[1])
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+      }
+    }
+  }
+
+  // One file per result against results packed into shards, on the smallest image, where
+  // the metadata operations of a file per result weigh the most.
+  for (const auto sink : kOutputSinks) {
+    Options sink_options = options;
+    sink_options.output_sink = sink;
+    const std::string name = sink == Options::OutputSink::kShards ? "shards" : "files";
+    benchmark::RegisterBenchmark(
+        ("BM_OutputSink/" + name + "/" + smallest->name).c_str(),
+        [image = *smallest, operations = kChains[1].make(*smallest),
+         sink_options](benchmark::State& state) {
+          RunPipeline(state, image, operations, sink_options);
+        })
+        ->Arg(kBatchSizes[1])
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+  }
+}
+
+} // namespace image_processor::bench
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <image_processor/cancellation.hpp>
 #include <image_processor/error.hpp>
 #include <image_processor/filter.hpp>
+#include <image_processor/ingest.hpp>
+#include <image_processor/options.hpp>
+#include <image_processor/pipeline.hpp>
+#include <image_processor/result_locator.hpp>
 #include <string>
+#include <system_error>
 #include <vector>
 
 namespace image_processor {
@@ -12,17 +18,135 @@ namespace image_processor {
  *
  * This function must be called before using any other functionality of the image
  * processor.
+ *
+ * @param options Runtime configuration: worker count, output directory, CPU pinning and
+ * NUMA policy. The defaults start one unpinned worker per available CPU that writes to
+ * "$HOME/processed_images".
+ * @throw std::runtime_error if the image processor is already running or the output
+ * directory cannot be created.
+ * @throw std::invalid_argument if OutputSink::kShards is combined with
+ * ExecutionMode::kOutOfProcess.
  */
-void Initialize();
+void Initialize(const Options& options = Options());
+
+/**
+ * @brief Validate and compile a chain of filters for repeated submission.
+ *
+ * Every filter is validated and the chain is planned once, here, instead of inside a
+ * worker for every task. Compiling an equal chain again returns a handle to the same plan.
+ *
+ * @param operations List of filters to be applied, in order.
+ * @return A handle to the compiled pipeline; check Pipeline::IsValid() to find out whether
+ * the chain was accepted.
+ */
+Pipeline CompilePipeline(std::vector<Filter> operations);
 
 /**
  * @brief Submit a new image processing task.
  *
+ * Equivalent to SubmitTask(image, CompilePipeline(operations), tag).
+ *
  * @param image Path to the image to be processed.
  * @param operations List of filters to be applied on the image.
+ * @param tag Optional tag for cancelling related tasks together with CancelTasksWithTag().
  * @return A unique task ID representing the submitted task.
  */
-std::string SubmitTask(std::string image, std::vector<Filter> operations);
+std::string SubmitTask(std::string image, std::vector<Filter> operations,
+                       std::string tag = {});
+
+/**
+ * @brief Submit a new image processing task that runs a precompiled pipeline.
+ *
+ * An invalid pipeline is rejected synchronously: the task is never queued and
+ * GetError() reports ImageProcessingError::kInvalidFilter for the returned ID right away.
+ *
+ * @param image Path to the image to be processed.
+ * @param pipeline Pipeline returned by CompilePipeline().
+ * @param tag Optional tag for cancelling related tasks together with CancelTasksWithTag().
+ * @return A unique task ID representing the submitted task.
+ */
+std::string SubmitTask(std::string image, const Pipeline& pipeline, std::string tag = {});
+
+/**
+ * @brief Submit one task per image listed in a manifest file, scheduled in disk order.
+ *
+ * The manifest lists one image path per line. Instead of running in manifest order, the
+ * tasks are queued in the order their images are stored on disk, and a background feeder
+ * prefetches each image as its task is queued, Options::ingest_window tasks ahead of the
+ * workers. Cold storage then serves a mostly sequential stream instead of random reads.
+ *
+ * Every task is created before the call returns, so its ID can be polled or cancelled
+ * right away, even while it waits in the feeder. An invalid pipeline fails every task
+ * with ImageProcessingError::kInvalidFilter, as with SubmitTask().
+ *
+ * @param manifest_path Path of the manifest file.
+ * @param pipeline Pipeline returned by CompilePipeline().
+ * @param tag Optional tag for cancelling the whole ingestion with CancelTasksWithTag().
+ * @return The images and the IDs of their tasks, in manifest order.
+ * @throw std::runtime_error if the manifest cannot be read.
+ */
+std::vector<IngestedTask> IngestManifest(const std::string& manifest_path,
+                                         const Pipeline& pipeline, std::string tag = {});
+
+/**
+ * @brief Submit one task per JPEG and PNG image in a directory tree, scheduled in disk
+ * order.
+ *
+ * Behaves like IngestManifest() with a manifest of every .jpg, .jpeg and .png file under
+ * @p directory.
+ *
+ * @param directory Root of the tree.
+ * @param pipeline Pipeline returned by CompilePipeline().
+ * @param tag Optional tag for cancelling the whole ingestion with CancelTasksWithTag().
+ * @return The images and the IDs of their tasks, sorted by path.
+ * @throw std::runtime_error if @p directory is not a readable directory.
+ */
+std::vector<IngestedTask> IngestDirectory(const std::string& directory,
+                                          const Pipeline& pipeline, std::string tag = {});
+
+/**
+ * @brief Cancel a submitted task.
+ *
+ * A queued task is dropped when a worker dequeues it, without being decoded; a running
+ * task stops before its next filter step or before its result is written. Either way
+ * GetError() then reports ImageProcessingError::kCancelled and no output is written. A
+ * task that is already writing its result completes normally.
+ *
+ * @param task_id The ID of the task to cancel.
+ * @return false if the task's outcome is stored, true otherwise. Cancelling an unknown
+ * task, or one whose result was already collected, has no effect.
+ */
+bool CancelTask(const std::string& task_id);
+
+/**
+ * @brief Cancel every task submitted with a tag so far.
+ *
+ * Behaves like CancelTask() for each of those tasks. Tasks submitted with the same tag
+ * after the call are not affected.
+ *
+ * @param tag Tag passed to SubmitTask().
+ */
+void CancelTasksWithTag(const std::string& tag);
+
+/**
+ * @brief Retrieve counters of the work saved by cancellation.
+ *
+ * @return Snapshot of the counters since the library was loaded.
+ */
+CancellationStats GetCancellationStats();
+
+/**
+ * @brief Retrieve why tasks could not be spilled to disk or read back.
+ *
+ * While the spill cannot be written (e.g. the disk is full), queued tasks are buffered in
+ * memory and eventually kept in memory instead of being spilled, so none is lost. If a
+ * spill file cannot be read back (e.g. it was deleted or truncated), the tasks it still
+ * held are lost: they never get a result or an error, and the error stays reported.
+ *
+ * @return Error of a spill file that could not be read back, otherwise of the latest
+ * failed spill write, or an empty error code once writes succeed again.
+ */
+std::error_code GetSpillError();
 
 /**
  * @brief Check if a processing task is complete.
@@ -49,12 +173,29 @@ ImageProcessingError GetError(const std::string& task_id);
  * @brief Retrieve the result of a processing task.
  *
  * Once retrieved, the result for the task will be removed from the internal storage.
+ * Results packed into a shard with Options::OutputSink::kShards are not files of their
+ * own: they are left for GetResultLocator().
  *
  * @param task_id The ID of the task to retrieve the result for.
- * @return Path to the processed image or an empty string if the task is not complete.
+ * @return Path to the processed image; an empty string if the task is not complete or its
+ * result is in a shard.
  */
 std::string GetResult(const std::string& task_id);
 
+/**
+ * @brief Retrieve where the result of a processing task is stored.
+ *
+ * Use this instead of GetResult() with Options::OutputSink::kShards: the locator gives
+ * the shard and the byte range of the encoded image in it. A result written to its own
+ * file spans the whole file. Once retrieved, the result for the task will be removed from
+ * the internal storage, as with GetResult(), whether it is in a shard or not.
+ *
+ * @param task_id The ID of the task to retrieve the result for.
+ * @return Where the encoded image is stored, or an empty file name if the task is not
+ * complete.
+ */
+ResultLocator GetResultLocator(const std::string& task_id);
+
 /**
  * @brief Shut down the image processor.
  *
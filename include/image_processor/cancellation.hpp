@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace image_processor {
+
+/**
+ * @struct CancellationStats
+ * @brief Counters of the work cancellation saved, returned by GetCancellationStats().
+ *
+ * Counters start at zero when the library is loaded and only grow.
+ */
+struct CancellationStats {
+  // clang-format off
+  std::uint64_t skipped_in_queue = 0;     ///< Cancelled tasks dropped when dequeued: never decoded, filtered or written.
+  std::uint64_t stopped_in_progress = 0;  ///< Cancelled tasks stopped between filter steps or before being written.
+  std::uint64_t filters_skipped = 0;      ///< Filters not applied because their task was cancelled, in either case.
+  std::uint64_t late_requests = 0;        ///< CancelTask() calls for tasks whose outcome was already stored.
+  // clang-format on
+};
+
+} // namespace image_processor
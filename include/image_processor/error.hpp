@@ -19,6 +19,9 @@ enum class ImageProcessingError {
   kImageInaccessible,  /**< The library was unable to access the provided image, possibly due to permissions or other restrictions. */
   kImageSaveError,     /**< The image was processed successfully but encountered an issue when attempting to save the result. */
   kInvalidFilter,      /**< The provided filter for processing is ill-formed or not recognized. */
+  kWorkerCrashed,      /**< Every worker process that attempted the task crashed or hung (out-of-process mode only). */
+  kCancelled,          /**< The task was cancelled before its result was written. */
+  kProcessingFailed,   /**< A filter failed on this image, e.g. a crop rectangle outside it or running out of memory. */
 };
 // clang-format on
 
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace image_processor {
+
+/**
+ * @struct IngestedTask
+ * @brief An image submitted by IngestManifest() or IngestDirectory() and the ID of the
+ * task that processes it.
+ */
+struct IngestedTask {
+  std::string image;   ///< Path of the input image.
+  std::string task_id; ///< ID to pass to GetResult(), GetError() or CancelTask().
+};
+
+} // namespace image_processor
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace image_processor {
+
+/**
+ * @struct Options
+ * @brief Runtime configuration of the image processor, passed to Initialize().
+ *
+ * Every field has a default that reproduces the behavior of a plain Initialize() call,
+ * so callers only need to set what they want to change.
+ */
+struct Options {
+
+  /**
+   * @enum CpuAffinity
+   * @brief Specifies how worker threads are pinned to CPUs.
+   */
+  enum class CpuAffinity {
+    kNone,    ///< Workers are not pinned and the OS scheduler may migrate them freely.
+    kCompact, ///< Workers are pinned to the CPUs of a NUMA node, filling one node first.
+    kScatter  ///< Workers are pinned to the CPUs of a NUMA node, spreading over nodes.
+  };
+
+  /**
+   * @enum NumaMode
+   * @brief Specifies how the processor accounts for NUMA topology.
+   */
+  enum class NumaMode {
+    kDisabled, ///< A single task queue shared by all workers.
+    kNodeLocal ///< One task queue per NUMA node; workers stay on, and allocate from, their
+               ///< node and only take tasks from other nodes when their own queue is empty.
+  };
+
+  /**
+   * @enum ExecutionMode
+   * @brief Specifies where filters run.
+   */
+  enum class ExecutionMode {
+    kInProcess,   ///< Worker threads of the calling process run the filters.
+    kOutOfProcess ///< Worker processes run the filters, so a crash or hang in a filter
+                  ///< only takes down that worker, which is restarted and its task retried.
+  };
+
+  /**
+   * @enum Concurrency
+   * @brief Specifies how CPUs are split between workers and the threads of their filters.
+   */
+  enum class Concurrency {
+    kFixed,   ///< Every worker runs, and filters use as many threads as OpenCV and TBB like.
+    kAdaptive ///< Fewer, wider workers for large images and many narrow ones for small
+              ///< images, so that workers times filter threads never exceed the CPUs.
+              ///< Sets OpenCV's thread count, which is process-wide, while running.
+  };
+
+  /**
+   * @enum OutputSink
+   * @brief Specifies how processed images are stored.
+   */
+  enum class OutputSink {
+    kFiles, ///< Each result is written to its own file in the output directory.
+    kShards ///< Results are packed into large tar shards in the output directory; see
+            ///< GetResultLocator(). In-process execution only; Initialize() rejects it
+            ///< with kOutOfProcess.
+  };
+
+  // clang-format off
+  std::size_t worker_count = 0;                ///< Number of worker threads (or processes), 0 for one per available CPU.
+  std::string output_directory;                ///< Directory for processed images, empty for "$HOME/processed_images".
+  CpuAffinity cpu_affinity = CpuAffinity::kNone; ///< Pinning policy for worker threads.
+  NumaMode numa_mode = NumaMode::kDisabled;    ///< NUMA policy for task queues and allocations.
+  std::size_t spill_threshold = 0;             ///< Tasks queued in memory before new ones spill to disk, 0 to never spill.
+  std::string spill_directory;                 ///< Directory for spilled tasks, empty for a directory under the system temporary directory.
+  ExecutionMode execution_mode = ExecutionMode::kInProcess; ///< Where filters run; pinning and NUMA options apply to in-process workers only.
+  std::string worker_executable;               ///< Path of image_processor_worker, empty to look next to the running executable.
+  std::size_t max_task_attempts = 3;           ///< Out-of-process: times a task may take down a worker before it fails with kWorkerCrashed.
+  std::uint32_t task_timeout_ms = 0;           ///< Out-of-process: a worker busy on one task for longer is killed as hung, 0 to never time out.
+  Concurrency concurrency = Concurrency::kFixed; ///< Split of CPUs between workers and filter threads.
+  std::uint64_t streaming_threshold = 100'000'000; ///< Images with at least this many pixels are processed in strips when the chain allows it, 0 to never stream.
+  std::size_t ingest_window = 128;             ///< Tasks from IngestManifest() and IngestDirectory() kept queued, with their inputs prefetched, ahead of the workers.
+  OutputSink output_sink = OutputSink::kFiles;  ///< How processed images are stored.
+  std::uint64_t shard_size = 1ull << 30;       ///< Shards: size at which a shard is completed and the next one started.
+  // clang-format on
+};
+
+} // namespace image_processor
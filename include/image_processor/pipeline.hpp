@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+
+namespace image_processor {
+
+class FilterChain;
+
+/**
+ * @class Pipeline
+ * @brief Handle to a precompiled chain of filters, returned by CompilePipeline().
+ *
+ * A pipeline is validated and planned once and can then be submitted with any number of
+ * images without repeating that work. Handles are cheap to copy and safe to share between
+ * threads; equal chains compiled separately share the same underlying plan.
+ */
+class Pipeline {
+public:
+  /**
+   * @brief Constructs an empty, invalid pipeline.
+   */
+  Pipeline() = default;
+
+  /**
+   * @brief Check if the pipeline can be submitted.
+   *
+   * @return true if every filter of the chain is well-formed and the chain as a whole can
+   * run (e.g. no crop exceeds the image size set by an earlier resize), false otherwise.
+   */
+  bool IsValid() const;
+
+private:
+  friend struct PipelineAccess;
+
+  explicit Pipeline(std::shared_ptr<const FilterChain> chain);
+
+  /**
+   * @brief The interned, compiled chain; null for a default-constructed pipeline.
+   */
+  std::shared_ptr<const FilterChain> chain_;
+};
+
+} // namespace image_processor
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace image_processor {
+
+/**
+ * @struct ResultLocator
+ * @brief Where an encoded result is stored, returned by GetResultLocator().
+ *
+ * A result written to its own file spans the whole file. A result packed into a shard
+ * spans the data of its tar entry, so it can be read with a single pread().
+ */
+struct ResultLocator {
+  std::string file;        ///< Path of the result file or shard, empty if not complete.
+  std::uint64_t offset = 0; ///< Offset of the encoded image in the file.
+  std::uint64_t length = 0; ///< Length of the encoded image in bytes.
+};
+
+} // namespace image_processor
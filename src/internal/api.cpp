@@ -1,30 +1,129 @@
 #include <image_processor/api.hpp>
 
+#include "cancellation_registry.hpp"
+#include "filter_chain.hpp"
+#include "ingest_feeder.hpp"
+#include "ingest_source.hpp"
 #include "task.hpp"
+#include "task_queue.hpp"
 #include "utils.hpp"
 #include "worker_pool.hpp"
 
+#include <filesystem>
+
 namespace image_processor {
 
-static tbb::concurrent_queue<Task> task_queue;
-static tbb::concurrent_hash_map<std::string, std::string> result_storage;
+static TaskQueue task_queue;
+static tbb::concurrent_hash_map<std::string, TaskResult> result_storage;
 static tbb::concurrent_hash_map<std::string, ImageProcessingError> error_storage;
-static WorkerPool worker_pool(task_queue, result_storage, error_storage);
+static CancellationRegistry cancellation_registry;
+static WorkerPool worker_pool(task_queue, result_storage, error_storage,
+                              cancellation_registry);
+static IngestFeeder ingest_feeder(task_queue);
+
+namespace {
+
+/**
+ * @brief Creates a task per image and hands them to the feeder, which queues them in
+ * disk order.
+ */
+std::vector<IngestedTask> Ingest(std::vector<std::string> images,
+                                 const Pipeline& pipeline, const std::string& tag) {
+  std::vector<IngestedTask> ingested;
+  ingested.reserve(images.size());
+  for (const auto& image : images) {
+    ingested.push_back({image, utils::GenerateUUID()});
+  }
+
+  if (!pipeline.IsValid()) {
+    for (const auto& task : ingested) {
+      error_storage.insert({task.task_id, ImageProcessingError::kInvalidFilter});
+    }
+    return ingested;
+  }
+
+  std::vector<Task> tasks;
+  tasks.reserve(images.size());
+  for (std::size_t i = 0; i < images.size(); ++i) {
+    Task task{ingested[i].task_id, std::move(images[i]), PipelineAccess::Chain(pipeline),
+              tag};
+    cancellation_registry.Register(task);
+    tasks.push_back(std::move(task));
+  }
+  ingest_feeder.Enqueue(std::move(tasks));
+  return ingested;
+}
 
-void Initialize() {
+} // namespace
+
+void Initialize(const Options& options) {
   result_storage.rehash(1048576);
-  worker_pool.Start();
+  worker_pool.Start(options);
+  try {
+    ingest_feeder.Start(options);
+  } catch (...) {
+    worker_pool.Stop();
+    throw;
+  }
 }
 
-std::string SubmitTask(std::string image, std::vector<Filter> operations) {
+Pipeline CompilePipeline(std::vector<Filter> operations) {
+  return PipelineAccess::Wrap(FilterChain::Intern(operations));
+}
+
+std::string SubmitTask(std::string image, std::vector<Filter> operations,
+                       std::string tag) {
+  return SubmitTask(std::move(image), CompilePipeline(std::move(operations)),
+                    std::move(tag));
+}
 
+std::string SubmitTask(std::string image, const Pipeline& pipeline, std::string tag) {
   std::string id = utils::GenerateUUID();
-  task_queue.push({id, image, operations});
+  if (!pipeline.IsValid()) {
+    error_storage.insert({id, ImageProcessingError::kInvalidFilter});
+    return id;
+  }
+
+  Task task{id, std::move(image), PipelineAccess::Chain(pipeline), std::move(tag)};
+  cancellation_registry.Register(task);
+  task_queue.Push(std::move(task));
   return id;
 }
 
+std::vector<IngestedTask> IngestManifest(const std::string& manifest_path,
+                                         const Pipeline& pipeline, std::string tag) {
+  return Ingest(ReadManifest(manifest_path), pipeline, tag);
+}
+
+std::vector<IngestedTask> IngestDirectory(const std::string& directory,
+                                          const Pipeline& pipeline, std::string tag) {
+  return Ingest(ListImages(directory), pipeline, tag);
+}
+
+bool CancelTask(const std::string& task_id) {
+  // The registry does not keep finished tasks, so their stored outcome tells.
+  tbb::concurrent_hash_map<std::string, TaskResult>::const_accessor result;
+  tbb::concurrent_hash_map<std::string, ImageProcessingError>::const_accessor error;
+  if (result_storage.find(result, task_id) || error_storage.find(error, task_id)) {
+    cancellation_registry.RecordLateRequest();
+    return false;
+  }
+
+  cancellation_registry.Cancel(task_id);
+  return true;
+}
+
+void CancelTasksWithTag(const std::string& tag) { cancellation_registry.CancelTag(tag); }
+
+CancellationStats GetCancellationStats() { return cancellation_registry.Stats(); }
+
+std::error_code GetSpillError() {
+  const std::error_code error = task_queue.SpillError();
+  return error ? error : ingest_feeder.SpillError();
+}
+
 bool IsTaskComplete(const std::string& task_id) {
-  tbb::concurrent_hash_map<std::string, std::string>::const_accessor accessor;
+  tbb::concurrent_hash_map<std::string, TaskResult>::const_accessor accessor;
   return result_storage.find(accessor, task_id);
 }
 
@@ -40,9 +139,9 @@ ImageProcessingError GetError(const std::string& task_id) {
 }
 
 std::string GetResult(const std::string& task_id) {
-  tbb::concurrent_hash_map<std::string, std::string>::accessor accessor;
-  if (result_storage.find(accessor, task_id)) {
-    std::string result = accessor->second;
+  tbb::concurrent_hash_map<std::string, TaskResult>::accessor accessor;
+  if (result_storage.find(accessor, task_id) && !accessor->second.in_shard) {
+    std::string result = std::move(accessor->second.locator.file);
     result_storage.erase(accessor);
     return result;
   }
@@ -50,6 +149,29 @@ std::string GetResult(const std::string& task_id) {
   return {};
 }
 
-void Shutdown() { worker_pool.Stop(); }
+ResultLocator GetResultLocator(const std::string& task_id) {
+  TaskResult result;
+  {
+    tbb::concurrent_hash_map<std::string, TaskResult>::accessor accessor;
+    if (!result_storage.find(accessor, task_id)) {
+      return {};
+    }
+    result = std::move(accessor->second);
+    result_storage.erase(accessor);
+  }
+
+  if (!result.in_shard) {
+    // A result written to its own file spans the whole file.
+    std::error_code error;
+    const auto size = std::filesystem::file_size(result.locator.file, error);
+    result.locator.length = error ? 0 : size;
+  }
+  return result.locator;
+}
+
+void Shutdown() {
+  ingest_feeder.Stop();
+  worker_pool.Stop();
+}
 
 } // namespace image_processor
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "cancellation_registry.hpp"
+
+#include <algorithm>
+
+namespace image_processor {
+
+CancellationRegistry::CancellationRegistry()
+    : next_sequence_(1), epochs_{{1, 0}}, pending_(0), generation_(0),
+      skipped_in_queue_(0), stopped_in_progress_(0), filters_skipped_(0),
+      late_requests_(0) {}
+
+void CancellationRegistry::Register(Task& task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  task.sequence = next_sequence_++;
+  ++epochs_.back().unfinished;
+}
+
+void CancellationRegistry::Finish(const std::string& task_id, std::uint64_t sequence) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cancelled_ids_.erase(task_id) != 0) {
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // The task belongs to the last epoch that starts at or before its sequence number.
+  auto epoch = std::upper_bound(epochs_.begin(), epochs_.end(), sequence,
+                                [](std::uint64_t value, const Epoch& epoch) {
+                                  return value < epoch.first_sequence;
+                                });
+  if (epoch == epochs_.begin() || (--epoch)->unfinished == 0) {
+    return;
+  }
+  if (--epoch->unfinished == 0 && epoch == epochs_.begin()) {
+    CollectGarbage();
+  }
+}
+
+void CancellationRegistry::Cancel(const std::string& task_id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cancelled_ids_.emplace(task_id, next_sequence_).second) {
+      return;
+    }
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    StartEpoch();
+  }
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+void CancellationRegistry::CancelTag(const std::string& tag) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Tasks registered from now on get a sequence number at or above this one.
+    const auto [entry, inserted] = cancelled_tags_.insert_or_assign(tag, next_sequence_);
+    if (inserted) {
+      pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    StartEpoch();
+  }
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+bool CancellationRegistry::IsCancelled(const Task& task) const {
+  if (pending_.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cancelled_ids_.count(task.id) != 0) {
+    return true;
+  }
+
+  if (task.tag.empty()) {
+    return false;
+  }
+
+  const auto tag = cancelled_tags_.find(task.tag);
+  return tag != cancelled_tags_.end() && task.sequence < tag->second;
+}
+
+std::size_t CancellationRegistry::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cancelled_ids_.size() + cancelled_tags_.size();
+}
+
+void CancellationRegistry::StartEpoch() {
+  if (epochs_.back().unfinished != 0) {
+    epochs_.push_back({next_sequence_, 0});
+  } else {
+    epochs_.back().first_sequence = next_sequence_;
+  }
+  if (epochs_.front().unfinished == 0) {
+    // No task registered before the cancellation is left, so nothing can match it.
+    CollectGarbage();
+  }
+}
+
+void CancellationRegistry::CollectGarbage() {
+  while (epochs_.size() > 1 && epochs_.front().unfinished == 0) {
+    epochs_.pop_front();
+  }
+
+  // Every task below this sequence number has finished.
+  const std::uint64_t finished_before =
+      epochs_.front().unfinished == 0 ? next_sequence_ : epochs_.front().first_sequence;
+  const auto collect = [&](std::unordered_map<std::string, std::uint64_t>& entries) {
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (it->second <= finished_before) {
+        it = entries.erase(it);
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+      } else {
+        ++it;
+      }
+    }
+  };
+  collect(cancelled_ids_);
+  collect(cancelled_tags_);
+}
+
+void CancellationRegistry::RecordSkipped(std::size_t filters) {
+  skipped_in_queue_.fetch_add(1, std::memory_order_relaxed);
+  filters_skipped_.fetch_add(filters, std::memory_order_relaxed);
+}
+
+void CancellationRegistry::RecordLateRequest() {
+  late_requests_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CancellationRegistry::RecordStopped(std::size_t filters_skipped) {
+  stopped_in_progress_.fetch_add(1, std::memory_order_relaxed);
+  filters_skipped_.fetch_add(filters_skipped, std::memory_order_relaxed);
+}
+
+CancellationStats CancellationRegistry::Stats() const {
+  CancellationStats stats;
+  stats.skipped_in_queue = skipped_in_queue_.load(std::memory_order_relaxed);
+  stats.stopped_in_progress = stopped_in_progress_.load(std::memory_order_relaxed);
+  stats.filters_skipped = filters_skipped_.load(std::memory_order_relaxed);
+  stats.late_requests = late_requests_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace image_processor
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "task.hpp"
+#include <image_processor/cancellation.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace image_processor {
+
+/**
+ * @class CancellationRegistry
+ * @brief Tracks which unfinished tasks have been cancelled, by ID or by tag.
+ *
+ * Only cancellations are stored, never the submitted tasks themselves, so a backlog of
+ * millions of queued or spilled tasks costs nothing here. Every task gets a sequence
+ * number when it is registered. Cancelling a task records its ID, and cancelling a tag
+ * records the current sequence number instead of walking the tag's tasks: a task carrying
+ * the tag is cancelled if it was registered before that point.
+ *
+ * Each cancellation also starts a new epoch, and the registry counts the unfinished tasks
+ * of every epoch. Once every task registered before a cancellation has finished, nothing
+ * can match it any more and it is dropped. An ID that finished, or never existed, is thus
+ * only kept until the tasks registered before it are done.
+ *
+ * Workers poll IsCancelled() when they dequeue a task, between filter steps and before
+ * saving. While no cancellation is pending the check is a single atomic load.
+ */
+class CancellationRegistry {
+public:
+  CancellationRegistry();
+
+  /**
+   * @brief Registers a task about to be queued and assigns its sequence number.
+   *
+   * @param task Task to register; its sequence field is set.
+   */
+  void Register(Task& task);
+
+  /**
+   * @brief Unregisters a task whose outcome has been stored.
+   *
+   * @param task_id ID of the task.
+   * @param sequence Sequence number assigned by Register().
+   */
+  void Finish(const std::string& task_id, std::uint64_t sequence);
+
+  /**
+   * @brief Cancels a task if it has not finished yet.
+   *
+   * The caller checks whether the task has finished; see RecordLateRequest().
+   */
+  void Cancel(const std::string& task_id);
+
+  /**
+   * @brief Cancels every task registered so far with the given tag.
+   */
+  void CancelTag(const std::string& tag);
+
+  /**
+   * @brief Returns true if the task has been cancelled, by ID or by tag.
+   */
+  bool IsCancelled(const Task& task) const;
+
+  /**
+   * @brief Returns a number that changes with every cancellation, so that pollers can
+   * skip looking for cancelled tasks while nothing was cancelled.
+   */
+  std::uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Returns the number of cancelled IDs and tags still tracked.
+   */
+  std::size_t Size() const;
+
+  /**
+   * @brief Records a cancelled task dropped before it was decoded.
+   *
+   * @param filters Filters of the task's chain.
+   */
+  void RecordSkipped(std::size_t filters);
+
+  /**
+   * @brief Records a cancelled task stopped while it was being processed.
+   *
+   * @param filters_skipped Filters of the task's chain that were not applied.
+   */
+  void RecordStopped(std::size_t filters_skipped);
+
+  /**
+   * @brief Records a cancellation request for a task that had already finished.
+   */
+  void RecordLateRequest();
+
+  /**
+   * @brief Returns a snapshot of the counters.
+   */
+  CancellationStats Stats() const;
+
+private:
+  /**
+   * @struct Epoch
+   * @brief Tasks registered between two cancellations.
+   */
+  struct Epoch {
+    std::uint64_t first_sequence; ///< Sequence number of the epoch's first task.
+    std::size_t unfinished;       ///< Tasks of the epoch not finished yet.
+  };
+
+  /**
+   * @brief Starts a new epoch at the next sequence number, unless the current one is
+   * still empty. Called with mutex_ held.
+   */
+  void StartEpoch();
+
+  /**
+   * @brief Drops finished epochs at the front and the cancellations no unfinished task
+   * can match any more. Called with mutex_ held.
+   */
+  void CollectGarbage();
+
+  /**
+   * @brief Guards everything below except the counters.
+   */
+  mutable std::mutex mutex_;
+
+  /**
+   * @brief Sequence number of the next registered task.
+   */
+  std::uint64_t next_sequence_;
+
+  /**
+   * @brief Epochs in sequence order; the last one receives new tasks.
+   */
+  std::deque<Epoch> epochs_;
+
+  /**
+   * @brief Cancelled task IDs, mapped to the next sequence number at their cancellation.
+   */
+  std::unordered_map<std::string, std::uint64_t> cancelled_ids_;
+
+  /**
+   * @brief Cancelled tags, mapped to the next sequence number at the latest cancellation.
+   */
+  std::unordered_map<std::string, std::uint64_t> cancelled_tags_;
+
+  /**
+   * @brief Entries in cancelled_ids_ and cancelled_tags_, read without the lock.
+   */
+  std::atomic<std::size_t> pending_;
+
+  /**
+   * @brief Number of cancellations so far.
+   */
+  std::atomic<std::uint64_t> generation_;
+
+  /**
+   * @brief Counters reported by Stats().
+   */
+  std::atomic<std::uint64_t> skipped_in_queue_;
+  std::atomic<std::uint64_t> stopped_in_progress_;
+  std::atomic<std::uint64_t> filters_skipped_;
+  std::atomic<std::uint64_t> late_requests_;
+};
+
+} // namespace image_processor
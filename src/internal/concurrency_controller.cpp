@@ -0,0 +1,251 @@
+#include "concurrency_controller.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace image_processor {
+
+namespace {
+
+constexpr std::uint64_t kUpdateIntervalNs = 250'000'000; // 250 ms
+
+/**
+ * @brief Input pixels worth one inner thread: images below this run single-threaded.
+ */
+constexpr double kPixelsPerInnerThread = 2'000'000;
+
+/**
+ * @brief Rough peak memory of a task per input pixel: the decoded image, float planes
+ * for SIPL filters and their scratch copies.
+ */
+constexpr double kBytesPerPixel = 64;
+
+/**
+ * @brief Share of the available memory the working sets of active workers may take.
+ */
+constexpr double kMemoryShare = 0.5;
+
+/**
+ * @brief Slowdown after a change of width that makes the controller revert it.
+ */
+constexpr double kRevertThreshold = 0.9;
+
+/**
+ * @brief Decisions during which a reverted width is kept.
+ */
+constexpr int kHoldIntervals = 20;
+
+/**
+ * @brief Images whose sizes differ by less than this factor count as similar.
+ */
+constexpr double kSimilarSizeFactor = 1.5;
+
+std::uint64_t NowNanoseconds() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+/**
+ * @brief Returns how many workers fit in memory at once.
+ */
+std::size_t MemoryLimit(const ConcurrencyController::Inputs& inputs) {
+  if (inputs.available_memory == 0 || inputs.average_pixels <= 0) {
+    return inputs.worker_count;
+  }
+
+  const double per_worker = inputs.average_pixels * kBytesPerPixel;
+  const double fitting = kMemoryShare * static_cast<double>(inputs.available_memory) /
+                         per_worker;
+  return std::max<std::size_t>(1, static_cast<std::size_t>(fitting));
+}
+
+/**
+ * @brief Returns the decision that gives each worker the given width.
+ */
+ConcurrencyController::Decision
+FitWidth(const ConcurrencyController::Inputs& inputs, std::size_t width) {
+  const std::size_t cpus = std::max<std::size_t>(inputs.cpu_count, 1);
+  const std::size_t workers = std::max<std::size_t>(inputs.worker_count, 1);
+  width = std::max<std::size_t>(width, 1);
+  std::size_t active = std::clamp<std::size_t>(cpus / width, 1, workers);
+  active = std::min(active, MemoryLimit(inputs));
+  return {active, static_cast<int>(width)};
+}
+
+} // namespace
+
+ConcurrencyController::Decision ConcurrencyController::Plan(const Inputs& inputs) {
+  const std::size_t cpus = std::max<std::size_t>(inputs.cpu_count, 1);
+
+  // Wide enough for the image...
+  std::size_t width = static_cast<std::size_t>(
+      std::clamp(std::ceil(inputs.average_pixels / kPixelsPerInnerThread), 1.0,
+                 static_cast<double>(cpus)));
+
+  // ...and to keep every CPU busy when fewer tasks than CPUs are waiting.
+  if (inputs.pending_tasks < cpus) {
+    width = std::max(width, cpus / std::max<std::size_t>(inputs.pending_tasks, 1));
+  }
+
+  Decision decision = FitWidth(inputs, width);
+
+  // Workers dropped for lack of memory leave CPUs to the remaining ones.
+  decision.inner_threads = static_cast<int>(
+      std::max(width, cpus / std::max<std::size_t>(decision.active_workers, 1)));
+  return decision;
+}
+
+std::uint64_t ConcurrencyController::ReadAvailableMemory() {
+  std::ifstream meminfo("/proc/meminfo");
+  std::string line;
+  while (std::getline(meminfo, line)) {
+    if (line.rfind("MemAvailable:", 0) != 0) {
+      continue;
+    }
+
+    std::istringstream fields(line.substr(13));
+    std::uint64_t kilobytes = 0;
+    fields >> kilobytes;
+    return kilobytes * 1024;
+  }
+
+  return 0;
+}
+
+ConcurrencyController::ConcurrencyController()
+    : adaptive_(false), worker_count_(0), cpu_count_(0), active_workers_(0),
+      inner_threads_(0), in_flight_(0), tasks_finished_(0), pixels_finished_(0),
+      last_update_ns_(0), last_tasks_(0), last_pixels_(0), average_pixels_(0),
+      hold_intervals_(0) {}
+
+void ConcurrencyController::Start(std::size_t worker_count, std::size_t cpu_count,
+                                  bool adaptive) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  adaptive_ = adaptive;
+  worker_count_ = std::max<std::size_t>(worker_count, 1);
+  cpu_count_ = std::max<std::size_t>(cpu_count, 1);
+  in_flight_.store(0);
+  tasks_finished_.store(0);
+  pixels_finished_.store(0);
+  last_update_ns_.store(NowNanoseconds());
+  last_tasks_ = 0;
+  last_pixels_ = 0;
+  average_pixels_ = 0;
+  previous_width_.reset();
+  hold_intervals_ = 0;
+
+  active_workers_.store(worker_count_);
+  if (inner_threads_.exchange(0) != 0 && !adaptive_) {
+    cv::setNumThreads(-1); // Back to OpenCV's default.
+  }
+  if (adaptive_) {
+    // Nothing is known about the load yet: every worker narrow, as many as fit.
+    Apply({worker_count_,
+           static_cast<int>(std::max<std::size_t>(1, cpu_count_ / worker_count_))});
+  }
+}
+
+void ConcurrencyController::Stop() {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  if (inner_threads_.exchange(0) != 0) {
+    cv::setNumThreads(-1);
+  }
+}
+
+void ConcurrencyController::TaskFinished(std::size_t pixels) {
+  in_flight_.fetch_sub(1, std::memory_order_relaxed);
+  pixels_finished_.fetch_add(pixels, std::memory_order_relaxed);
+  tasks_finished_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ConcurrencyController::MaybeUpdate(std::size_t queue_depth) {
+  if (!adaptive_) {
+    return;
+  }
+
+  const std::uint64_t now = NowNanoseconds();
+  if (now - last_update_ns_.load(std::memory_order_relaxed) < kUpdateIntervalNs) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(update_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || now - last_update_ns_.load() < kUpdateIntervalNs) {
+    return;
+  }
+
+  const double seconds = static_cast<double>(now - last_update_ns_.load()) / 1e9;
+  last_update_ns_.store(now);
+
+  const std::uint64_t tasks = tasks_finished_.load();
+  const std::uint64_t pixels = pixels_finished_.load();
+  const std::uint64_t finished = tasks - last_tasks_;
+  const double throughput = static_cast<double>(pixels - last_pixels_) / seconds;
+  if (finished > 0) {
+    const double average = static_cast<double>(pixels - last_pixels_) / finished;
+    average_pixels_ =
+        average_pixels_ == 0 ? average : 0.7 * average_pixels_ + 0.3 * average;
+  }
+  last_tasks_ = tasks;
+  last_pixels_ = pixels;
+
+  const Inputs inputs{cpu_count_, worker_count_, average_pixels_,
+                      queue_depth + in_flight_.load(), ReadAvailableMemory()};
+  Apply(Decide(inputs, finished, throughput));
+}
+
+ConcurrencyController::Decision
+ConcurrencyController::Decide(const Inputs& inputs, std::uint64_t finished,
+                              double throughput) {
+  const int width = inner_threads_.load();
+  if (inputs.pending_tasks == 0) {
+    // Idle: keep the last decision rather than plan a single worker for an empty queue.
+    return {active_workers_.load(), width};
+  }
+
+  Decision decision = Plan(inputs);
+
+  // Throughput only says something about a width while every active worker is busy.
+  const bool saturated = inputs.pending_tasks >= active_workers_.load() && finished > 0;
+
+  if (previous_width_ && saturated) {
+    const WidthSample previous = *previous_width_;
+    previous_width_.reset();
+    const double size_ratio = std::max(previous.average_pixels, inputs.average_pixels) /
+                              std::max(1.0, std::min(previous.average_pixels,
+                                                     inputs.average_pixels));
+    if (size_ratio < kSimilarSizeFactor &&
+        throughput < kRevertThreshold * previous.throughput) {
+      hold_intervals_ = kHoldIntervals;
+      return FitWidth(inputs, static_cast<std::size_t>(previous.width));
+    }
+  }
+
+  if (hold_intervals_ > 0) {
+    --hold_intervals_;
+    return FitWidth(inputs, static_cast<std::size_t>(width));
+  }
+
+  if (decision.inner_threads != width && saturated) {
+    previous_width_ = WidthSample{width, throughput, inputs.average_pixels};
+  }
+  return decision;
+}
+
+void ConcurrencyController::Apply(const Decision& decision) {
+  active_workers_.store(decision.active_workers);
+  if (inner_threads_.exchange(decision.inner_threads) != decision.inner_threads) {
+    // Process-wide: it also applies to OpenCV calls the application makes itself, until
+    // Stop() restores the default.
+    cv::setNumThreads(decision.inner_threads);
+  }
+}
+
+} // namespace image_processor
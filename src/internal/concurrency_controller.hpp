@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+namespace image_processor {
+
+/**
+ * @class ConcurrencyController
+ * @brief Splits the CPUs between worker threads and the threads each worker's filters
+ * may use internally (OpenCV's pool and TBB), so that the two levels together never
+ * oversubscribe the machine.
+ *
+ * Workers report every task they finish. At most every 250 ms the controller turns
+ * those reports, the queue depth and the memory available into a number of active
+ * workers and an inner width per worker, whose product stays within the CPU count:
+ * - large images get wide workers, small images many narrow ones;
+ * - when fewer tasks are waiting than there are CPUs, the workers that do run get wider;
+ * - when the working set of all active workers would not fit in half of the available
+ *   memory, fewer, wider workers run.
+ *
+ * The measured pixel throughput guards every change of width: if the new width turns out
+ * more than 10% slower than the previous one on similar images, the controller goes back
+ * and holds the previous width for a while.
+ */
+class ConcurrencyController {
+public:
+  /**
+   * @struct Inputs
+   * @brief What a decision is based on.
+   */
+  struct Inputs {
+    std::size_t cpu_count;           ///< CPUs available to the process.
+    std::size_t worker_count;        ///< Worker threads in the pool.
+    double average_pixels;           ///< Recent average input size, in pixels.
+    std::size_t pending_tasks;       ///< Tasks queued or being processed.
+    std::uint64_t available_memory;  ///< Bytes of memory available, 0 if unknown.
+  };
+
+  /**
+   * @struct Decision
+   * @brief How many workers run and how many threads each may use.
+   */
+  struct Decision {
+    std::size_t active_workers; ///< Workers allowed to take tasks.
+    int inner_threads;          ///< Threads per worker for OpenCV and TBB.
+  };
+
+  /**
+   * @brief Computes the decision for the given inputs, without throughput feedback.
+   */
+  static Decision Plan(const Inputs& inputs);
+
+  /**
+   * @brief Returns MemAvailable from /proc/meminfo in bytes, 0 if it cannot be read.
+   */
+  static std::uint64_t ReadAvailableMemory();
+
+  ConcurrencyController();
+
+  /**
+   * @brief Resets the controller for a pool of workers.
+   *
+   * @param worker_count Worker threads in the pool.
+   * @param cpu_count CPUs available to the process.
+   * @param adaptive false to keep every worker active and leave the libraries' own
+   * threading alone, as before the controller existed.
+   */
+  void Start(std::size_t worker_count, std::size_t cpu_count, bool adaptive);
+
+  /**
+   * @brief Gives OpenCV its default thread count back once the workers have stopped.
+   */
+  void Stop();
+
+  /**
+   * @brief Records that a worker started a task.
+   */
+  void TaskStarted() { in_flight_.fetch_add(1, std::memory_order_relaxed); }
+
+  /**
+   * @brief Records that a worker finished a task.
+   *
+   * @param pixels Number of pixels of the input image, 0 if it could not be read.
+   */
+  void TaskFinished(std::size_t pixels);
+
+  /**
+   * @brief Makes a new decision if the last one is older than 250 ms. Cheap to call after
+   * every task: only one caller at a time does the work, the others return.
+   *
+   * @param queue_depth Tasks currently waiting in the queue.
+   */
+  void MaybeUpdate(std::size_t queue_depth);
+
+  /**
+   * @brief Returns true if the worker with this index may take tasks.
+   */
+  bool IsActive(std::size_t worker_index) const {
+    return worker_index < active_workers_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns the threads a worker's filters may use, 0 if not limited.
+   */
+  int InnerThreads() const { return inner_threads_.load(std::memory_order_relaxed); }
+
+private:
+  /**
+   * @brief Applies a decision: publishes it to the workers and resizes OpenCV's pool.
+   */
+  void Apply(const Decision& decision);
+
+  /**
+   * @brief Plans with throughput feedback; called with update_mutex_ held.
+   *
+   * @param inputs Inputs of the plan.
+   * @param finished Tasks finished since the last decision.
+   * @param throughput Input pixels per second since the last decision.
+   */
+  Decision Decide(const Inputs& inputs, std::uint64_t finished, double throughput);
+
+  /**
+   * @brief False to keep every worker active and leave inner threading alone.
+   */
+  bool adaptive_;
+
+  /**
+   * @brief Worker threads in the pool.
+   */
+  std::size_t worker_count_;
+
+  /**
+   * @brief CPUs available to the process.
+   */
+  std::size_t cpu_count_;
+
+  /**
+   * @brief Workers with a lower index may take tasks.
+   */
+  std::atomic<std::size_t> active_workers_;
+
+  /**
+   * @brief Threads per worker for OpenCV and TBB, 0 if not limited.
+   */
+  std::atomic<int> inner_threads_;
+
+  /**
+   * @brief Tasks started and not yet finished.
+   */
+  std::atomic<std::size_t> in_flight_;
+
+  /**
+   * @brief Tasks finished since Start().
+   */
+  std::atomic<std::uint64_t> tasks_finished_;
+
+  /**
+   * @brief Input pixels of the tasks finished since Start().
+   */
+  std::atomic<std::uint64_t> pixels_finished_;
+
+  /**
+   * @brief Time of the last decision.
+   */
+  std::atomic<std::uint64_t> last_update_ns_;
+
+  /**
+   * @brief Guards the state below; held only by the thread making a decision.
+   */
+  std::mutex update_mutex_;
+
+  /**
+   * @brief tasks_finished_ and pixels_finished_ at the last decision.
+   */
+  std::uint64_t last_tasks_;
+  std::uint64_t last_pixels_;
+
+  /**
+   * @brief Moving average of the input size, in pixels.
+   */
+  double average_pixels_;
+
+  /**
+   * @struct WidthSample
+   * @brief Throughput measured with a width, before it was changed.
+   */
+  struct WidthSample {
+    int width;
+    double throughput;
+    double average_pixels;
+  };
+
+  /**
+   * @brief The width before the last change, to revert the change if it made things
+   * slower.
+   */
+  std::optional<WidthSample> previous_width_;
+
+  /**
+   * @brief Decisions left during which a reverted width is kept.
+   */
+  int hold_intervals_;
+};
+
+} // namespace image_processor
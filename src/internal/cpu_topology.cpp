@@ -0,0 +1,176 @@
+#include "cpu_topology.hpp"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace image_processor {
+
+namespace {
+
+/**
+ * @brief Parses a sysfs CPU list such as "0-3,8,10-11".
+ */
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty() || !std::isdigit(static_cast<unsigned char>(range.front()))) {
+      continue;
+    }
+
+    const auto dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> UsableCpus() {
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  std::vector<int> cpus;
+  if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &mask)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+} // namespace
+
+CpuTopology CpuTopology::Detect() {
+  const std::vector<int> usable = UsableCpus();
+  CpuTopology topology;
+
+  std::vector<std::filesystem::path> node_dirs;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+        std::isdigit(static_cast<unsigned char>(name[4]))) {
+      node_dirs.push_back(entry.path());
+    }
+  }
+  std::sort(node_dirs.begin(), node_dirs.end(), [](const auto& lhs, const auto& rhs) {
+    return std::stoi(lhs.filename().string().substr(4)) <
+           std::stoi(rhs.filename().string().substr(4));
+  });
+
+  for (const auto& node_dir : node_dirs) {
+    std::ifstream file(node_dir / "cpulist");
+    std::string list;
+    std::getline(file, list);
+
+    std::vector<int> cpus;
+    for (const int cpu : ParseCpuList(list)) {
+      if (std::find(usable.begin(), usable.end(), cpu) != usable.end()) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      topology.node_cpus.push_back(std::move(cpus));
+      topology.node_ids.push_back(std::stoi(node_dir.filename().string().substr(4)));
+    }
+  }
+
+  if (topology.node_cpus.empty()) {
+    topology.node_cpus.push_back(usable);
+    topology.node_ids.push_back(-1);
+  }
+  if (topology.node_cpus.front().empty()) {
+    topology.node_cpus.front().push_back(0);
+  }
+
+  return topology;
+}
+
+std::size_t CpuTopology::CpuCount() const {
+  std::size_t count = 0;
+  for (const auto& cpus : node_cpus) {
+    count += cpus.size();
+  }
+  return count;
+}
+
+std::vector<WorkerPlacement> PlanWorkerPlacement(const CpuTopology& topology,
+                                                 std::size_t worker_count,
+                                                 Options::CpuAffinity affinity,
+                                                 Options::NumaMode numa_mode) {
+  const std::size_t node_count = topology.node_cpus.size();
+
+  // CPU visiting order: node by node for compact, interleaved across nodes for scatter.
+  std::vector<std::pair<int, std::size_t>> order;
+  if (affinity == Options::CpuAffinity::kScatter) {
+    for (std::size_t index = 0; order.size() < topology.CpuCount(); ++index) {
+      for (std::size_t node = 0; node < node_count; ++node) {
+        if (index < topology.node_cpus[node].size()) {
+          order.emplace_back(topology.node_cpus[node][index], node);
+        }
+      }
+    }
+  } else {
+    for (std::size_t node = 0; node < node_count; ++node) {
+      for (const int cpu : topology.node_cpus[node]) {
+        order.emplace_back(cpu, node);
+      }
+    }
+  }
+
+  std::vector<WorkerPlacement> placements(worker_count);
+  for (std::size_t worker = 0; worker < worker_count; ++worker) {
+    auto& placement = placements[worker];
+    if (affinity != Options::CpuAffinity::kNone) {
+      placement.node = order[worker % order.size()].second;
+      placement.cpus = topology.node_cpus[placement.node];
+    } else if (numa_mode == Options::NumaMode::kNodeLocal) {
+      placement.node = worker % node_count;
+      placement.cpus = topology.node_cpus[placement.node];
+    } else {
+      placement.node = 0;
+    }
+    placement.numa_node = topology.node_ids[placement.node];
+  }
+
+  return placements;
+}
+
+void ApplyWorkerPlacement(const WorkerPlacement& placement, Options::NumaMode numa_mode) {
+  if (!placement.cpus.empty()) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (const int cpu : placement.cpus) {
+      CPU_SET(cpu, &mask);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+  }
+
+  if (numa_mode == Options::NumaMode::kNodeLocal && placement.numa_node >= 0) {
+    // Preferred rather than bound, so allocations fall back to other nodes when the
+    // worker's node runs out of memory. maxnode counts one bit past the last node.
+    constexpr int kMaskBits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> nodes(placement.numa_node / kMaskBits + 1, 0);
+    nodes[placement.numa_node / kMaskBits] |= 1UL << (placement.numa_node % kMaskBits);
+    syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes.data(),
+            static_cast<unsigned long>(nodes.size() * kMaskBits + 1));
+  }
+}
+
+} // namespace image_processor
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <image_processor/options.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @struct CpuTopology
+ * @brief CPUs available to this process, grouped by NUMA node.
+ */
+struct CpuTopology {
+
+  /**
+   * @brief CPU ids of every NUMA node that has at least one CPU usable by this process.
+   */
+  std::vector<std::vector<int>> node_cpus;
+
+  /**
+   * @brief Kernel NUMA node id of each entry of node_cpus, -1 if NUMA is not exposed.
+   */
+  std::vector<int> node_ids;
+
+  /**
+   * @brief Detects the topology from sysfs, restricted to the process affinity mask.
+   *
+   * Falls back to a single node holding every usable CPU when sysfs does not expose NUMA
+   * information (e.g. in containers or on non-NUMA kernels).
+   *
+   * @return The detected topology, never empty.
+   */
+  static CpuTopology Detect();
+
+  /**
+   * @brief Returns the total number of CPUs across all nodes.
+   */
+  std::size_t CpuCount() const;
+};
+
+/**
+ * @struct WorkerPlacement
+ * @brief Where a single worker thread runs and which task queue it prefers.
+ */
+struct WorkerPlacement {
+  std::vector<int> cpus; ///< CPUs the worker is pinned to, empty if it is not pinned.
+  std::size_t node;      ///< Index of the worker's node in CpuTopology::node_cpus.
+  int numa_node = -1;    ///< Kernel id of that node, -1 if NUMA is not exposed.
+};
+
+/**
+ * @brief Plans the placement of worker threads.
+ *
+ * Pinned workers are pinned to every CPU of their node rather than to a single CPU:
+ * the OpenCV and TBB threads a worker starts for parallel filters inherit its mask, and
+ * would otherwise all share the worker's one CPU. Compact and scatter differ in how
+ * workers are assigned to nodes.
+ *
+ * @param topology Topology of the machine.
+ * @param worker_count Number of workers to place.
+ * @param affinity Pinning policy.
+ * @param numa_mode NUMA policy. In node-local mode unpinned workers are still confined to
+ * the CPUs of their node.
+ * @return One placement per worker.
+ */
+std::vector<WorkerPlacement> PlanWorkerPlacement(const CpuTopology& topology,
+                                                 std::size_t worker_count,
+                                                 Options::CpuAffinity affinity,
+                                                 Options::NumaMode numa_mode);
+
+/**
+ * @brief Applies a placement to the calling thread.
+ *
+ * Pins the thread to the placement's CPUs and, in node-local mode, makes it prefer memory
+ * of its node, so buffers it touches first (decoded images, filter outputs) come from
+ * there. Threads it starts later inherit both. Failures are ignored: placement is an
+ * optimization only.
+ *
+ * @param placement Placement to apply.
+ * @param numa_mode NUMA policy.
+ */
+void ApplyWorkerPlacement(const WorkerPlacement& placement, Options::NumaMode numa_mode);
+
+} // namespace image_processor
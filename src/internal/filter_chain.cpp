@@ -0,0 +1,140 @@
+#include "filter_chain.hpp"
+
+#include <cstring>
+#include <string>
+#include <tbb/concurrent_hash_map.h>
+
+namespace image_processor {
+
+namespace {
+
+static_assert(sizeof(CompactFilter) == 16, "CompactFilter is expected to pack into 16 bytes");
+
+using Registry = tbb::concurrent_hash_map<std::string, std::weak_ptr<const FilterChain>>;
+
+/**
+ * @brief Returns the registry of live chains, keyed by the bytes of their filters.
+ *
+ * Intentionally leaked: chains held by static objects in other translation units may be
+ * released after this one's statics are destroyed.
+ */
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+bool IsBetweenZeroAndOne(float value) { return 0 <= value && value <= 1; }
+
+bool IsValidFilter(const Filter& filter) {
+  switch (filter.type) {
+  case Filter::Type::Resize:
+    return filter.width.has_value() && filter.height.has_value();
+  case Filter::Type::Crop:
+    return filter.x.has_value() && filter.y.has_value() && filter.width.has_value() &&
+           filter.height.has_value() && *filter.x < *filter.width &&
+           filter.y < *filter.height;
+  case Filter::Type::Blur:
+    return filter.kernel_size.has_value();
+  case Filter::Type::Watercolor:
+    return filter.brush_size.has_value() && filter.brush_hardness.has_value() &&
+           filter.brush_strength.has_value() && IsBetweenZeroAndOne(*filter.brush_size) &&
+           IsBetweenZeroAndOne(*filter.brush_hardness) &&
+           IsBetweenZeroAndOne(*filter.brush_strength);
+  case Filter::Type::Cartoonize:
+    return filter.detalization_level.has_value() &&
+           IsBetweenZeroAndOne(*filter.detalization_level);
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+std::optional<CompactFilter> CompactFilter::FromFilter(const Filter& filter) {
+  if (!IsValidFilter(filter)) {
+    return std::nullopt;
+  }
+
+  CompactFilter compact{};
+  compact.type = filter.type;
+  switch (filter.type) {
+  case Filter::Type::Resize:
+    compact.params.resize = {*filter.width, *filter.height};
+    break;
+  case Filter::Type::Crop:
+    compact.params.crop = {*filter.x, *filter.y, *filter.width, *filter.height};
+    break;
+  case Filter::Type::Blur:
+    compact.params.blur = {*filter.kernel_size};
+    break;
+  case Filter::Type::Watercolor:
+    compact.params.watercolor = {*filter.brush_size, *filter.brush_hardness,
+                                 *filter.brush_strength};
+    break;
+  case Filter::Type::Cartoonize:
+    compact.params.cartoonize = {*filter.detalization_level};
+    break;
+  }
+
+  return compact;
+}
+
+FilterChain::FilterChain(std::vector<CompactFilter> filters,
+                         std::vector<PipelineStep> steps, bool valid)
+    : filters_(std::move(filters)), steps_(std::move(steps)), valid_(valid) {}
+
+std::shared_ptr<const FilterChain> FilterChain::Intern(const std::vector<Filter>& operations) {
+  std::vector<CompactFilter> filters;
+  filters.reserve(operations.size());
+  for (const auto& filter : operations) {
+    const auto compact = CompactFilter::FromFilter(filter);
+    if (!compact) {
+      return Invalid();
+    }
+    filters.push_back(*compact);
+  }
+
+  return Intern(std::move(filters));
+}
+
+std::shared_ptr<const FilterChain> FilterChain::Intern(std::vector<CompactFilter> filters) {
+  // Filters are value-initialized before their parameters are set, so every byte,
+  // including those past a short union member, is deterministic.
+  std::string key(filters.size() * sizeof(CompactFilter), '\0');
+  if (!filters.empty()) {
+    std::memcpy(key.data(), filters.data(), key.size());
+  }
+
+  Registry& registry = GetRegistry();
+  Registry::accessor accessor;
+  registry.insert(accessor, key);
+  if (auto chain = accessor->second.lock()) {
+    return chain;
+  }
+
+  auto steps = PlanPipeline(filters);
+  if (!steps) {
+    registry.erase(accessor);
+    return Invalid();
+  }
+
+  std::shared_ptr<const FilterChain> chain(
+      new FilterChain(std::move(filters), std::move(*steps), true),
+      [key](const FilterChain* released) {
+        Registry& registry = GetRegistry();
+        Registry::accessor accessor;
+        if (registry.find(accessor, key) && accessor->second.expired()) {
+          registry.erase(accessor);
+        }
+        delete released;
+      });
+  accessor->second = chain;
+  return chain;
+}
+
+std::shared_ptr<const FilterChain> FilterChain::Invalid() {
+  static const std::shared_ptr<const FilterChain> invalid(new FilterChain({}, {}, false));
+  return invalid;
+}
+
+} // namespace image_processor
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "pipeline_plan.hpp"
+#include <image_processor/filter.hpp>
+#include <image_processor/pipeline.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @struct CompactFilter
+ * @brief Type-tagged, fixed-size representation of a validated Filter.
+ *
+ * Filter keeps every parameter of every type as a std::optional; CompactFilter stores only
+ * the parameters of its own type in a union, which brings a filter down to 16 bytes.
+ */
+struct CompactFilter {
+  Filter::Type type; ///< The type of the filter, selects the active member of params.
+
+  // clang-format off
+  union Params {
+    struct { float brush_size, brush_hardness, brush_strength; } watercolor; ///< Watercolor parameters.
+    struct { std::uint16_t x, y, width, height; } crop;                    ///< Crop rectangle.
+    struct { std::uint16_t width, height; } resize;                        ///< Resize target size.
+    struct { std::uint8_t kernel_size; } blur;                             ///< Blur kernel size.
+    struct { float detalization_level; } cartoonize;                       ///< Cartoonize level of detail.
+  } params; ///< Parameters of the filter; watercolor is first so value-initialization zeroes all bytes.
+  // clang-format on
+
+  /**
+   * @brief Converts a validated Filter.
+   *
+   * @param filter Filter to convert.
+   * @return The compact filter, or std::nullopt if the filter is not valid.
+   */
+  static std::optional<CompactFilter> FromFilter(const Filter& filter);
+};
+
+/**
+ * @class FilterChain
+ * @brief Immutable, interned and compiled sequence of filters shared by every task that
+ * uses it.
+ *
+ * Chains are only created through Intern(), which returns the same instance for equal
+ * sequences of filters for as long as any task holds it, so a backlog of millions of tasks
+ * that use a handful of distinct chains stores each of them once. Each chain is validated
+ * and compiled into PipelineSteps exactly once, when it is first interned. An invalid
+ * sequence (e.g. a filter with missing parameters) maps to a single shared invalid chain.
+ */
+class FilterChain {
+public:
+  /**
+   * @brief Validates and interns a sequence of filters.
+   *
+   * @param operations Filters in the order they are applied.
+   * @return The shared chain for @p operations; invalid if any filter is invalid.
+   */
+  static std::shared_ptr<const FilterChain> Intern(const std::vector<Filter>& operations);
+
+  /**
+   * @brief Interns a sequence of already validated compact filters.
+   *
+   * @param filters Filters in the order they are applied.
+   * @return The shared chain for @p filters; invalid if the sequence cannot be compiled.
+   */
+  static std::shared_ptr<const FilterChain> Intern(std::vector<CompactFilter> filters);
+
+  /**
+   * @brief Returns the shared invalid chain.
+   */
+  static std::shared_ptr<const FilterChain> Invalid();
+
+  /**
+   * @brief Returns false if the chain was built from an invalid sequence of filters.
+   */
+  bool IsValid() const { return valid_; }
+
+  /**
+   * @brief Returns the filters in the order they are applied; empty for an invalid chain.
+   */
+  const std::vector<CompactFilter>& Filters() const { return filters_; }
+
+  /**
+   * @brief Returns the compiled steps that apply the filters; empty for an invalid chain.
+   */
+  const std::vector<PipelineStep>& Steps() const { return steps_; }
+
+private:
+  FilterChain(std::vector<CompactFilter> filters, std::vector<PipelineStep> steps,
+              bool valid);
+
+  /**
+   * @brief Filters in the order they are applied.
+   */
+  const std::vector<CompactFilter> filters_;
+
+  /**
+   * @brief Compiled steps that apply filters_.
+   */
+  const std::vector<PipelineStep> steps_;
+
+  /**
+   * @brief False if the chain was built from an invalid sequence of filters.
+   */
+  const bool valid_;
+};
+
+/**
+ * @struct PipelineAccess
+ * @brief Gives the library access to the chain behind a public Pipeline handle.
+ */
+struct PipelineAccess {
+  static Pipeline Wrap(std::shared_ptr<const FilterChain> chain) {
+    return Pipeline(std::move(chain));
+  }
+
+  static const std::shared_ptr<const FilterChain>& Chain(const Pipeline& pipeline) {
+    return pipeline.chain_;
+  }
+};
+
+} // namespace image_processor
@@ -1,43 +1,15 @@
 #include "image_processor.hpp"
-#include "utils.hpp"
+#include "strip_pipeline.hpp"
+#include <algorithm>
 #include <cctype>
+#include <fstream>
 #include <opencv2/imgcodecs.hpp>
-
-#include <lib1/filters/blur.h>
-#include <lib2/filters/watercolor.h>
-#include <lib3/filters/cartoonize.h>
-#include <lib4/filters/resize.h>
-#include <lib5/filters/crop.h>
+#include <utility>
 
 namespace image_processor {
 
 namespace {
 
-bool IsBetweenZeroAndOne(float value) { return 0 <= value && value <= 1; }
-
-bool IsValidFilter(const Filter& filter) {
-  switch (filter.type) {
-  case Filter::Type::Resize:
-    return filter.width.has_value() && filter.height.has_value();
-  case Filter::Type::Crop:
-    return filter.x.has_value() && filter.y.has_value() && filter.width.has_value() &&
-           filter.height.has_value() && *filter.x < *filter.width &&
-           filter.y < *filter.height;
-  case Filter::Type::Blur:
-    return filter.kernel_size.has_value();
-  case Filter::Type::Watercolor:
-    return filter.brush_size.has_value() && filter.brush_hardness.has_value() &&
-           filter.brush_strength.has_value() && IsBetweenZeroAndOne(*filter.brush_size) &&
-           IsBetweenZeroAndOne(*filter.brush_hardness) &&
-           IsBetweenZeroAndOne(*filter.brush_strength);
-  case Filter::Type::Cartoonize:
-    return filter.detalization_level.has_value() &&
-           IsBetweenZeroAndOne(*filter.detalization_level);
-  default:
-    return false;
-  }
-}
-
 ImageProcessingError CheckImage(const std::string& original_image_path_) {
   size_t pos = original_image_path_.rfind('.');
   if (pos == std::string::npos) {
@@ -67,11 +39,14 @@ ImageProcessingError CheckImage(const std::string& original_image_path_) {
 } // namespace
 
 ImageProcessor::ImageProcessor(const std::string& original_image_path_,
-                               const std::vector<Filter>& operations,
-                               const std::string& processed_images_path)
+                               const FilterChain& operations,
+                               const std::string& processed_images_path,
+                               std::uint64_t streaming_threshold,
+                               std::function<bool()> is_cancelled)
     : original_image_path_(original_image_path_), operations_(operations),
       processed_images_path_(processed_images_path),
-      image_(cv::imread(original_image_path_)) {}
+      streaming_threshold_(streaming_threshold), encode_to_memory_(false),
+      input_pixels_(0), is_cancelled_(std::move(is_cancelled)), skipped_filters_(0) {}
 
 ImageProcessingError ImageProcessor::ProcessImage() {
   auto error_code = ValidateArguments();
@@ -79,11 +54,22 @@ ImageProcessingError ImageProcessor::ProcessImage() {
     return error_code;
   }
 
+  if (auto decoder = OpenForStreaming()) {
+    return StreamFilters(*decoder);
+  }
+
+  image_ = cv::imread(original_image_path_);
+  input_pixels_ = image_.total();
+
   error_code = ApplyFilters();
   if (error_code != ImageProcessingError::kNoError) {
     return error_code;
   }
 
+  if (is_cancelled_ && is_cancelled_()) {
+    return ImageProcessingError::kCancelled;
+  }
+
   error_code = SaveImage();
   if (error_code != ImageProcessingError::kNoError) {
     return error_code;
@@ -92,61 +78,68 @@ ImageProcessingError ImageProcessor::ProcessImage() {
   return ImageProcessingError::kNoError;
 }
 
+void ImageProcessor::EncodeToMemory() { encode_to_memory_ = true; }
+
+std::vector<uchar> ImageProcessor::TakeEncodedImage() {
+  return std::move(encoded_image_);
+}
+
 std::string ImageProcessor::GetResultImagePath() const {
   return result_image_path_.string();
 }
 
-ImageProcessingError ImageProcessor::ValidateArguments() const {
-  for (const auto& filter : operations_) {
-    if (!IsValidFilter(filter)) {
-      return ImageProcessingError::kInvalidFilter;
-    }
-  }
+std::size_t ImageProcessor::GetInputPixelCount() const {
+  return input_pixels_;
+}
+
+std::size_t ImageProcessor::GetSkippedFilterCount() const {
+  return skipped_filters_;
+}
 
+ImageProcessingError ImageProcessor::ValidateArguments() const {
   return CheckImage(original_image_path_);
 }
 
 ImageProcessingError ImageProcessor::ApplyFilters() {
-  for (const auto& filter : operations_) {
-    switch (filter.type) {
-    case Filter::Type::Resize:
-      lib4::resize(image_, image_, cv::Size(*filter.width, *filter.height));
-      break;
-
-    case Filter::Type::Blur: {
-      cv::Size kernelSize(*filter.kernel_size, *filter.kernel_size);
-      lib1::blur(image_, image_, kernelSize);
-      break;
+  for (const auto& step : operations_.Steps()) {
+    if (is_cancelled_ && is_cancelled_()) {
+      skipped_filters_ = operations_.Filters().size() - step.first;
+      return ImageProcessingError::kCancelled;
     }
+    step.kernel(image_, operations_.Filters().data() + step.first, step.count);
+  }
 
-    case Filter::Type::Watercolor:
-      lib2::watercolor(image_, image_, *filter.brush_size, *filter.brush_hardness,
-                       *filter.brush_strength);
-      break;
-
-    case Filter::Type::Cartoonize: {
-      SIPL::Image<float> siplImage = utils::ConvertToSIPL(image_);
-      SIPL::Image<float> cartoonized =
-          lib3::cartoonize(siplImage, *filter.detalization_level);
-      image_ = utils::ConvertToCV(cartoonized);
-      break;
-    }
+  return ImageProcessingError::kNoError;
+}
 
-    case Filter::Type::Crop: {
-      cv::Rect rect(*filter.x, *filter.y, *filter.width, *filter.height);
-      lib5::crop(image_, image_, rect);
-      break;
-    }
+std::unique_ptr<StripDecoder> ImageProcessor::OpenForStreaming() const {
+  if (streaming_threshold_ == 0 || !IsStreamable(operations_)) {
+    return nullptr;
+  }
 
-    default:
-      return ImageProcessingError::kInvalidFilter;
-    }
+  // Only the header is read here; smaller images are decoded as a whole.
+  auto decoder = StripDecoder::Open(original_image_path_);
+  if (!decoder || static_cast<std::uint64_t>(decoder->Width()) * decoder->Height() <
+                      streaming_threshold_) {
+    return nullptr;
   }
+  return decoder;
+}
 
-  return ImageProcessingError::kNoError;
+ImageProcessingError ImageProcessor::StreamFilters(StripDecoder& decoder) {
+  input_pixels_ = static_cast<std::size_t>(decoder.Width()) * decoder.Height();
+  ReserveResultPath();
+
+  const auto error_code =
+      StreamImage(decoder, operations_, result_image_path_.string(), is_cancelled_);
+  if (error_code == ImageProcessingError::kCancelled) {
+    // Every filter runs on every strip, so none of them completed.
+    skipped_filters_ = operations_.Filters().size();
+  }
+  return error_code;
 }
 
-ImageProcessingError ImageProcessor::SaveImage() {
+void ImageProcessor::ReserveResultPath() {
   std::string base_filename = std::filesystem::path(original_image_path_).stem().string();
   std::string extension =
       std::filesystem::path(original_image_path_).extension().string();
@@ -159,7 +152,19 @@ ImageProcessingError ImageProcessor::SaveImage() {
                          (base_filename + "_" + std::to_string(counter) + extension);
     counter++;
   }
+}
+
+ImageProcessingError ImageProcessor::SaveImage() {
+  if (encode_to_memory_) {
+    const std::string extension =
+        std::filesystem::path(original_image_path_).extension().string();
+    if (!cv::imencode(extension, image_, encoded_image_)) {
+      return ImageProcessingError::kImageSaveError;
+    }
+    return ImageProcessingError::kNoError;
+  }
 
+  ReserveResultPath();
   if (!cv::imwrite(result_image_path_.string(), image_)) {
     return ImageProcessingError::kImageSaveError;
   }
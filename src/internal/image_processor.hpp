@@ -1,10 +1,15 @@
 #pragma once
 
+#include "filter_chain.hpp"
+#include "strip_codec.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
 #include <image_processor/error.hpp>
-#include <image_processor/filter.hpp>
 #include <opencv2/core.hpp>
-#include <vector>
 
 namespace image_processor {
 
@@ -15,7 +20,12 @@ namespace image_processor {
  *
  * The ImageProcessor class takes in an original image path and a series of filter
  * operations to apply on the image. After processing, the resultant image is saved in the
- * specified directory.
+ * specified directory. An optional cancellation check is polled between filter steps and
+ * before saving, so a cancelled task stops without writing any output.
+ *
+ * The image is only decoded by ProcessImage(). Images of at least the streaming threshold
+ * whose chain only has row-local filters are never decoded as a whole: they are streamed
+ * from decoder to encoder in strips, so memory does not grow with the image height.
  */
 class ImageProcessor {
 public:
@@ -23,12 +33,16 @@ public:
    * @brief Constructor for the ImageProcessor class.
    *
    * @param original_image_path Path to the original image to be processed.
-   * @param operations List of filter operations to apply on the image.
+   * @param operations Chain of filter operations to apply on the image.
    * @param processed_images_path Path to save the processed image.
+   * @param streaming_threshold Pixel count from which images are streamed, 0 to never
+   * stream.
+   * @param is_cancelled Returns true once the task is cancelled; empty if it cannot be.
    */
-  ImageProcessor(const std::string& original_image_path,
-                 const std::vector<Filter>& operations,
-                 const std::string& processed_images_path);
+  ImageProcessor(const std::string& original_image_path, const FilterChain& operations,
+                 const std::string& processed_images_path,
+                 std::uint64_t streaming_threshold = 0,
+                 std::function<bool()> is_cancelled = {});
 
   /**
    * @brief Processes the image based on the provided filter operations.
@@ -37,6 +51,21 @@ public:
    */
   ImageProcessingError ProcessImage();
 
+  /**
+   * @brief Makes ProcessImage() keep the encoded result in memory, for
+   * TakeEncodedImage(), instead of writing it to the output directory. Streamed images
+   * are still written to their own file.
+   */
+  void EncodeToMemory();
+
+  /**
+   * @brief Hands over the result encoded by ProcessImage() after EncodeToMemory().
+   *
+   * @return The image encoded in the format of the original, empty if it was written to
+   * GetResultImagePath() instead.
+   */
+  std::vector<uchar> TakeEncodedImage();
+
   /**
    * @brief Retrieves the path where the processed image is saved.
    *
@@ -44,23 +73,61 @@ public:
    */
   std::string GetResultImagePath() const;
 
+  /**
+   * @brief Retrieves the number of pixels of the original image.
+   *
+   * @return Pixels of the original image, 0 if it could not be read or ProcessImage() has
+   * not run yet.
+   */
+  std::size_t GetInputPixelCount() const;
+
+  /**
+   * @brief Retrieves the number of filters not applied because the task was cancelled.
+   *
+   * @return Filters skipped, 0 unless ProcessImage() returned kCancelled.
+   */
+  std::size_t GetSkippedFilterCount() const;
+
 private:
   /**
-   * @brief Validates the provided filter operations and image path.
+   * @brief Validates the image path.
+   *
+   * Filter operations are not validated here: only valid, compiled chains are queued.
    *
    * @return ImageProcessingError status indicating success or the nature of any error.
    */
   ImageProcessingError ValidateArguments() const;
 
   /**
-   * @brief Applies the specified filter operations on the image.
+   * @brief Applies the specified filter operations on the image by running the chain's
+   * precompiled steps, checking for cancellation before each step.
    *
    * @return ImageProcessingError status indicating success or the nature of any error.
    */
   ImageProcessingError ApplyFilters();
 
   /**
-   * @brief Saves the processed image to the specified path.
+   * @brief Opens the image for streaming if it and the chain qualify.
+   *
+   * @return The decoder, with only the header read, or null to decode the whole image.
+   */
+  std::unique_ptr<StripDecoder> OpenForStreaming() const;
+
+  /**
+   * @brief Applies the filters strip by strip and writes the result as it goes.
+   *
+   * @return ImageProcessingError status indicating success or the nature of any error.
+   */
+  ImageProcessingError StreamFilters(StripDecoder& decoder);
+
+  /**
+   * @brief Picks a path for the result in the output directory that is not taken yet.
+   */
+  void ReserveResultPath();
+
+  /**
+   * @brief Saves the processed image to the specified path, or encodes it in memory after
+   * EncodeToMemory().
    *
    * @return ImageProcessingError status indicating success or the nature of any error.
    */
@@ -73,24 +140,54 @@ private:
   const std::string& original_image_path_;
 
   /**
-   * @brief List of filter operations to apply on the image.
+   * @brief Chain of filter operations to apply on the image.
    */
-  const std::vector<Filter>& operations_;
+  const FilterChain& operations_;
 
   /**
    * @brief Directory path to save the processed image.
    */
   const std::string& processed_images_path_;
 
+  /**
+   * @brief Pixel count from which images are streamed, 0 to never stream.
+   */
+  std::uint64_t streaming_threshold_;
+
   /**
    * @brief Path where the processed image is saved after processing.
    */
   std::filesystem::path result_image_path_;
 
   /**
-   * @brief OpenCV matrix storing the image data.
+   * @brief OpenCV matrix storing the image data, once decoded by ProcessImage().
    */
   cv::Mat image_;
+
+  /**
+   * @brief True if the result is encoded into encoded_image_ instead of a file.
+   */
+  bool encode_to_memory_;
+
+  /**
+   * @brief The encoded result after EncodeToMemory(), empty otherwise.
+   */
+  std::vector<uchar> encoded_image_;
+
+  /**
+   * @brief Number of pixels of the original image, before any filter is applied.
+   */
+  std::size_t input_pixels_;
+
+  /**
+   * @brief Cancellation check, empty if the task cannot be cancelled.
+   */
+  std::function<bool()> is_cancelled_;
+
+  /**
+   * @brief Filters not applied because the task was cancelled.
+   */
+  std::size_t skipped_filters_;
 };
 
 } // namespace image_processor
@@ -0,0 +1,122 @@
+#include "ingest_feeder.hpp"
+#include "ingest_source.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace image_processor {
+
+IngestFeeder::IngestFeeder(TaskQueue& task_queue)
+    : task_queue_(task_queue), window_(1), pending_count_(0), running_(false) {}
+
+IngestFeeder::~IngestFeeder() {
+  if (thread_.joinable()) {
+    Stop();
+  }
+}
+
+void IngestFeeder::Start(const Options& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    throw std::runtime_error("Ingest feeder is already running.");
+  }
+
+  // Next to the task queue's own segments, which would otherwise share their names.
+  const std::filesystem::path spill_directory =
+      options.spill_directory.empty()
+          ? std::filesystem::temp_directory_path() / "image_processor_spill"
+          : std::filesystem::path(options.spill_directory);
+  pending_.ConfigureSpill(options.spill_threshold, spill_directory / "ingest");
+
+  window_ = std::max<std::size_t>(options.ingest_window, 1);
+  running_ = true;
+  thread_ = std::thread(&IngestFeeder::Run, this);
+}
+
+void IngestFeeder::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void IngestFeeder::Enqueue(std::vector<Task> tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unordered_.push_back(std::move(tasks));
+  }
+  wake_.notify_all();
+}
+
+void IngestFeeder::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock,
+               [this] { return !running_ || !unordered_.empty() || pending_count_ > 0; });
+    if (!running_) {
+      return;
+    }
+
+    // Ordering a batch takes one lookup per file; the queue keeps the window meanwhile.
+    if (!unordered_.empty()) {
+      std::vector<Task> batch = std::move(unordered_.front());
+      unordered_.pop_front();
+      lock.unlock();
+      std::vector<std::string> paths;
+      paths.reserve(batch.size());
+      for (const auto& task : batch) {
+        paths.push_back(task.image);
+      }
+      for (const std::size_t index : OrderOnDisk(paths)) {
+        pending_.Push(std::move(batch[index]));
+      }
+      lock.lock();
+      pending_count_ += batch.size();
+      continue;
+    }
+
+    // Workers do not signal dequeues, so a full window is polled like an empty queue is.
+    if (task_queue_.MemorySize() >= window_) {
+      wake_.wait_for(lock, std::chrono::milliseconds(1), [this] { return !running_; });
+      continue;
+    }
+
+    Task task;
+    if (!pending_.TryPop(task, 0)) {
+      // Only spilled tasks that cannot be read back get here; retry like a full window.
+      wake_.wait_for(lock, std::chrono::milliseconds(1), [this] { return !running_; });
+      continue;
+    }
+    --pending_count_;
+    lock.unlock();
+    Prefetch(task.image);
+    task_queue_.Push(std::move(task));
+    lock.lock();
+  }
+}
+
+void IngestFeeder::Prefetch(const std::string& path) {
+  // A missing or unreadable image is reported by the worker that processes it.
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  // The readahead is only started here; closing the file does not cancel it.
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+}
+
+} // namespace image_processor
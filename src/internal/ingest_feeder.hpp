@@ -0,0 +1,122 @@
+#pragma once
+
+#include "task.hpp"
+#include "task_queue.hpp"
+#include <image_processor/options.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @class IngestFeeder
+ * @brief Moves ingested tasks into the task queue a few at a time, prefetching their
+ * inputs.
+ *
+ * IngestManifest() and IngestDirectory() hand over their tasks in list order. A
+ * background thread puts each batch in disk order with OrderOnDisk(), so the calls do not
+ * wait for every file to be looked up, and appends it to the tasks waiting in the
+ * feeder. Those are held in a TaskQueue of their own, which spills to disk past
+ * spill_threshold like the task queue does, so a backfill of millions of images does not
+ * stay in memory.
+ *
+ * The thread keeps the in-memory task queue at most ingest_window tasks deep and, as it
+ * queues each task, asks the kernel to start reading the task's image with
+ * posix_fadvise(POSIX_FADV_WILLNEED). By the time a worker dequeues the task its input is
+ * usually in the page cache, and the storage sees one mostly sequential stream instead of
+ * one random read per worker. The feeder holds at most one file open at a time, and the
+ * prefetched data is bounded by the window.
+ *
+ * Tasks waiting in the feeder are kept across Stop() and Start(), like queued tasks.
+ */
+class IngestFeeder {
+public:
+  /**
+   * @param task_queue Queue the tasks are moved into.
+   */
+  explicit IngestFeeder(TaskQueue& task_queue);
+
+  ~IngestFeeder();
+
+  /**
+   * @brief Starts the feeder thread.
+   *
+   * @param options Runtime configuration; ingest_window and the spill settings are used.
+   * @throw std::system_error if the spill directory is not writable.
+   */
+  void Start(const Options& options);
+
+  /**
+   * @brief Stops the feeder thread; tasks not queued yet wait for the next Start().
+   */
+  void Stop();
+
+  /**
+   * @brief Appends tasks behind those already waiting, to be queued in disk order.
+   *
+   * @param tasks Registered tasks.
+   */
+  void Enqueue(std::vector<Task> tasks);
+
+  /**
+   * @brief Returns the spill error of the waiting tasks, as TaskQueue::SpillError().
+   */
+  std::error_code SpillError() { return pending_.SpillError(); }
+
+private:
+  /**
+   * @brief Feeder thread: orders new batches, then queues waiting tasks while the queue
+   * is below the window.
+   */
+  void Run();
+
+  /**
+   * @brief Starts reading a file into the page cache without waiting for it.
+   */
+  static void Prefetch(const std::string& path);
+
+  TaskQueue& task_queue_;
+
+  /**
+   * @brief Queued tasks the feeder keeps ahead of the workers.
+   */
+  std::size_t window_;
+
+  /**
+   * @brief Guards unordered_, pending_count_ and running_.
+   */
+  std::mutex mutex_;
+
+  /**
+   * @brief Signalled when tasks are enqueued or the feeder stops.
+   */
+  std::condition_variable wake_;
+
+  /**
+   * @brief Ingested batches not put in disk order yet.
+   */
+  std::deque<std::vector<Task>> unordered_;
+
+  /**
+   * @brief Ordered tasks not moved into the task queue yet. Only the feeder thread pushes
+   * and pops, and Start() configures it while the thread is not running.
+   */
+  TaskQueue pending_;
+
+  /**
+   * @brief Number of tasks in pending_, spilled ones included.
+   */
+  std::size_t pending_count_;
+
+  bool running_;
+  std::thread thread_;
+};
+
+} // namespace image_processor
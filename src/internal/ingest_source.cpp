@@ -0,0 +1,149 @@
+#include "ingest_source.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <numeric>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tuple>
+#include <unistd.h>
+
+namespace image_processor {
+
+namespace {
+
+/**
+ * @brief Returns true for the extensions ImageProcessor accepts.
+ */
+bool IsImage(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension == ".jpg" || extension == ".jpeg" || extension == ".png";
+}
+
+/**
+ * @struct DiskPosition
+ * @brief Sort key of a file: where its data starts on disk, or the best substitute known.
+ */
+struct DiskPosition {
+  /**
+   * @enum Kind
+   * @brief What offset holds; within a device, files are sorted by kind first.
+   */
+  enum class Kind { kPhysical, kInode, kMissing };
+
+  std::uint64_t device = std::numeric_limits<std::uint64_t>::max();
+  Kind kind = Kind::kMissing;
+  std::uint64_t offset = 0;
+
+  bool operator<(const DiskPosition& other) const {
+    return std::tie(device, kind, offset) <
+           std::tie(other.device, other.kind, other.offset);
+  }
+};
+
+DiskPosition LocateOnDisk(const std::string& path) {
+  DiskPosition position;
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return position;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0) {
+    position.device = info.st_dev;
+    position.kind = DiskPosition::Kind::kInode;
+    position.offset = info.st_ino;
+
+    // Only the first extent is needed; FIEMAP_FLAG_SYNC is left out so that looking up
+    // a file never forces a writeback.
+    alignas(fiemap) unsigned char request[sizeof(fiemap) + sizeof(fiemap_extent)] = {};
+    auto* map = reinterpret_cast<fiemap*>(request);
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents == 1 &&
+        (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN) == 0) {
+      position.kind = DiskPosition::Kind::kPhysical;
+      position.offset = map->fm_extents[0].fe_physical;
+    }
+  }
+
+  close(fd);
+  return position;
+}
+
+} // namespace
+
+std::vector<std::string> ReadManifest(const std::string& manifest_path) {
+  std::ifstream manifest(manifest_path);
+  if (!manifest) {
+    throw std::runtime_error("Cannot read manifest " + manifest_path);
+  }
+
+  std::vector<std::string> paths;
+  std::string line;
+  while (std::getline(manifest, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (!line.empty()) {
+      paths.push_back(std::move(line));
+    }
+  }
+
+  if (manifest.bad()) {
+    throw std::runtime_error("Cannot read manifest " + manifest_path);
+  }
+  return paths;
+}
+
+std::vector<std::string> ListImages(const std::string& directory) {
+  std::error_code error;
+  std::filesystem::recursive_directory_iterator it(
+      directory, std::filesystem::directory_options::skip_permission_denied, error);
+  if (error) {
+    throw std::runtime_error("Cannot read directory " + directory + ": " +
+                             error.message());
+  }
+
+  std::vector<std::string> paths;
+  for (; !error && it != std::filesystem::recursive_directory_iterator();
+       it.increment(error)) {
+    std::error_code ignored; // Broken symlinks are skipped like any other non-file.
+    if (it->is_regular_file(ignored) && IsImage(it->path())) {
+      paths.push_back(it->path().string());
+    }
+  }
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+std::vector<std::size_t> OrderOnDisk(const std::vector<std::string>& paths) {
+  std::vector<DiskPosition> positions(paths.size());
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, paths.size()),
+                    [&](const tbb::blocked_range<std::size_t>& range) {
+                      for (std::size_t i = range.begin(); i != range.end(); ++i) {
+                        positions[i] = LocateOnDisk(paths[i]);
+                      }
+                    });
+
+  std::vector<std::size_t> order(paths.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+    return positions[lhs] < positions[rhs];
+  });
+  return order;
+}
+
+} // namespace image_processor
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @brief Reads the image paths listed in a manifest file, one per line.
+ *
+ * Empty lines are skipped and a trailing carriage return is dropped, so manifests written
+ * on Windows work too. Paths are used as written, like the paths given to SubmitTask().
+ *
+ * @param manifest_path Path of the manifest file.
+ * @return The paths in manifest order.
+ * @throw std::runtime_error if the manifest cannot be read.
+ */
+std::vector<std::string> ReadManifest(const std::string& manifest_path);
+
+/**
+ * @brief Lists the JPEG and PNG images of a directory tree.
+ *
+ * Subdirectories that cannot be read are skipped.
+ *
+ * @param directory Root of the tree.
+ * @return The paths of the images, sorted.
+ * @throw std::runtime_error if @p directory is not a readable directory.
+ */
+std::vector<std::string> ListImages(const std::string& directory);
+
+/**
+ * @brief Orders files by where their data starts on disk.
+ *
+ * Files are sorted by device, then by the physical offset of their first extent, as
+ * reported by the FIEMAP ioctl. Files on file systems without FIEMAP (tmpfs, NFS, ...)
+ * are sorted by inode number instead, which most file systems allocate close to the data.
+ * Missing files go last. Files are opened in parallel, each only while it is looked up.
+ *
+ * @param paths Paths of the files.
+ * @return Indices into @p paths, in disk order.
+ */
+std::vector<std::size_t> OrderOnDisk(const std::vector<std::string>& paths);
+
+} // namespace image_processor
@@ -0,0 +1,121 @@
+#include "pipeline_plan.hpp"
+#include "filter_chain.hpp"
+#include "utils.hpp"
+
+#include <lib1/filters/blur.h>
+#include <lib2/filters/watercolor.h>
+#include <lib3/filters/cartoonize.h>
+#include <lib4/filters/resize.h>
+#include <lib5/filters/crop.h>
+
+namespace image_processor {
+
+namespace {
+
+void ResizeKernel(cv::Mat& image, const CompactFilter* filters, std::size_t) {
+  const auto& params = filters->params.resize;
+  lib4::resize(image, image, cv::Size(params.width, params.height));
+}
+
+void CropKernel(cv::Mat& image, const CompactFilter* filters, std::size_t) {
+  const auto& params = filters->params.crop;
+  lib5::crop(image, image, cv::Rect(params.x, params.y, params.width, params.height));
+}
+
+void BlurKernel(cv::Mat& image, const CompactFilter* filters, std::size_t) {
+  const auto& params = filters->params.blur;
+  lib1::blur(image, image, cv::Size(params.kernel_size, params.kernel_size));
+}
+
+void WatercolorKernel(cv::Mat& image, const CompactFilter* filters, std::size_t) {
+  const auto& params = filters->params.watercolor;
+  lib2::watercolor(image, image, params.brush_size, params.brush_hardness,
+                   params.brush_strength);
+}
+
+/**
+ * @brief Applies a run of SIPL filters with a single conversion in each direction.
+ */
+void SiplKernel(cv::Mat& image, const CompactFilter* filters, std::size_t count) {
+  if (image.channels() == 3) {
+    SIPL::Image<SIPL::color_float> sipl_image = utils::ConvertToSIPLColor(image);
+    for (std::size_t i = 0; i < count; ++i) {
+      sipl_image =
+          lib3::cartoonize(sipl_image, filters[i].params.cartoonize.detalization_level);
+    }
+    image = utils::ConvertToCV(sipl_image);
+    return;
+  }
+
+  SIPL::Image<float> sipl_image = utils::ConvertToSIPL(image);
+  for (std::size_t i = 0; i < count; ++i) {
+    sipl_image = lib3::cartoonize(sipl_image, filters[i].params.cartoonize.detalization_level);
+  }
+  image = utils::ConvertToCV(sipl_image);
+}
+
+bool IsSiplFilter(const CompactFilter& filter) {
+  return filter.type == Filter::Type::Cartoonize;
+}
+
+} // namespace
+
+std::optional<std::vector<PipelineStep>>
+PlanPipeline(const std::vector<CompactFilter>& filters) {
+  std::vector<PipelineStep> steps;
+  std::optional<PipelineStep::Size> size;
+
+  for (std::size_t i = 0; i < filters.size(); ++i) {
+    const CompactFilter& filter = filters[i];
+    const auto& params = filter.params;
+    PipelineStep step{nullptr, i, 1, false, false, std::nullopt};
+
+    switch (filter.type) {
+    case Filter::Type::Resize:
+      if (params.resize.width == 0 || params.resize.height == 0) {
+        return std::nullopt;
+      }
+      step.kernel = ResizeKernel;
+      size = PipelineStep::Size{params.resize.width, params.resize.height};
+      break;
+
+    case Filter::Type::Crop:
+      if (size && (params.crop.x + params.crop.width > size->width ||
+                   params.crop.y + params.crop.height > size->height)) {
+        return std::nullopt;
+      }
+      step.kernel = CropKernel;
+      step.row_local = true;
+      size = PipelineStep::Size{params.crop.width, params.crop.height};
+      break;
+
+    case Filter::Type::Blur:
+      step.kernel = BlurKernel;
+      step.row_local = true;
+      break;
+
+    case Filter::Type::Watercolor:
+      step.kernel = WatercolorKernel;
+      break;
+
+    case Filter::Type::Cartoonize:
+      step.kernel = SiplKernel;
+      step.sipl_domain = true;
+      while (i + 1 < filters.size() && IsSiplFilter(filters[i + 1])) {
+        ++step.count;
+        ++i;
+      }
+      break;
+
+    default:
+      return std::nullopt;
+    }
+
+    step.output_size = size;
+    steps.push_back(step);
+  }
+
+  return steps;
+}
+
+} // namespace image_processor
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace cv {
+class Mat;
+} // namespace cv
+
+namespace image_processor {
+
+struct CompactFilter;
+
+/**
+ * @struct PipelineStep
+ * @brief One step of a compiled pipeline: a kernel resolved ahead of time and the filters
+ * it applies.
+ *
+ * Most steps apply a single filter. Consecutive filters that run in the SIPL domain are
+ * fused into one step, so the image is converted to SIPL and back once per run instead of
+ * once per filter.
+ */
+struct PipelineStep {
+
+  /**
+   * @brief Signature shared by all step kernels; they transform the image in place.
+   */
+  using Kernel = void (*)(cv::Mat& image, const CompactFilter* filters, std::size_t count);
+
+  /**
+   * @struct Size
+   * @brief Image size in pixels.
+   */
+  struct Size {
+    std::uint16_t width;
+    std::uint16_t height;
+  };
+
+  Kernel kernel;      ///< Kernel that applies the step.
+  std::size_t first;  ///< Index of the step's first filter in the chain.
+  std::size_t count;  ///< Number of filters the step applies.
+  bool sipl_domain;   ///< True if the step converts to SIPL and back around its filters.
+  bool row_local;     ///< True if the step can run on horizontal strips of the image.
+  std::optional<Size> output_size; ///< Size of the step's output if known at compile time.
+};
+
+/**
+ * @brief Compiles a sequence of validated filters into pipeline steps.
+ *
+ * Resolves the kernel of every filter, fuses runs of SIPL filters and propagates image
+ * sizes through the chain: once a Resize or Crop fixes the size, every later Crop is
+ * checked against it, so a rectangle that cannot fit is rejected here instead of failing
+ * inside a worker.
+ *
+ * @param filters Filters in the order they are applied.
+ * @return The steps, or std::nullopt if the chain can never run successfully.
+ */
+std::optional<std::vector<PipelineStep>>
+PlanPipeline(const std::vector<CompactFilter>& filters);
+
+} // namespace image_processor
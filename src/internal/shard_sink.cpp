@@ -0,0 +1,283 @@
+#include "shard_sink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace image_processor {
+
+namespace {
+
+constexpr std::size_t kBlockSize = 512;
+constexpr std::size_t kTrailerSize = 2 * kBlockSize;
+
+/**
+ * @brief Size of the ustar name field; a name of exactly this size has no terminator.
+ */
+constexpr std::size_t kMaxNameSize = 100;
+
+/**
+ * @brief Pending bytes that make the sink write a batch without waiting any longer.
+ */
+constexpr std::size_t kBatchBytes = 8 << 20;
+
+/**
+ * @brief Pending bytes above which Append() waits for the sink to catch up.
+ */
+constexpr std::size_t kMaxPendingBytes = 4 * kBatchBytes;
+
+/**
+ * @brief Longest a result waits for its batch to fill up.
+ */
+constexpr auto kBatchDelay = std::chrono::milliseconds(10);
+
+std::uint64_t PaddedSize(std::uint64_t size) {
+  return (size + kBlockSize - 1) / kBlockSize * kBlockSize;
+}
+
+void WriteOctal(unsigned char* field, std::size_t width, std::uint64_t value) {
+  std::snprintf(reinterpret_cast<char*>(field), width, "%0*llo",
+                static_cast<int>(width - 1), static_cast<unsigned long long>(value));
+}
+
+/**
+ * @brief Appends a ustar header for a regular file named at most kMaxNameSize bytes.
+ */
+void AppendTarHeader(std::vector<unsigned char>& out, const std::string& name,
+                     std::uint64_t size) {
+  unsigned char header[kBlockSize] = {};
+  std::memcpy(header, name.data(), name.size());
+  WriteOctal(header + 100, 8, 0644);
+  WriteOctal(header + 108, 8, 0);
+  WriteOctal(header + 116, 8, 0);
+  if (size < (std::uint64_t{1} << 33)) {
+    WriteOctal(header + 124, 12, size);
+  } else {
+    // GNU base-256 encoding for entries of 8 GiB and more.
+    header[124] = 0x80;
+    for (int i = 0; i < 8; ++i) {
+      header[135 - i] = static_cast<unsigned char>(size >> (8 * i));
+    }
+  }
+  WriteOctal(header + 136, 12, static_cast<std::uint64_t>(std::time(nullptr)));
+  header[156] = '0';
+  std::memcpy(header + 257, "ustar", 6);
+  std::memcpy(header + 263, "00", 2);
+
+  // The checksum is computed with its own field filled with spaces.
+  std::memset(header + 148, ' ', 8);
+  unsigned int checksum = 0;
+  for (const unsigned char byte : header) {
+    checksum += byte;
+  }
+  WriteOctal(header + 148, 7, checksum);
+
+  out.insert(out.end(), header, header + kBlockSize);
+}
+
+bool WriteAt(int fd, const unsigned char* data, std::size_t size, std::uint64_t offset) {
+  while (size > 0) {
+    const ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+    offset += static_cast<std::uint64_t>(written);
+  }
+  return true;
+}
+
+} // namespace
+
+ShardSink::ShardSink(const std::filesystem::path& directory, std::uint64_t shard_size)
+    : directory_(directory), shard_size_(shard_size), pending_bytes_(0), stopping_(false),
+      next_shard_id_(0), shard_fd_(-1), shard_written_(0), index_fd_(-1),
+      index_written_(0), thread_(&ShardSink::Run, this) {}
+
+ShardSink::~ShardSink() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+void ShardSink::Append(std::string name, std::vector<unsigned char> data, Callback done) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  space_.wait(lock, [this] { return pending_bytes_ < kMaxPendingBytes; });
+  pending_bytes_ += data.size();
+  pending_.push_back({std::move(name), std::move(data), std::move(done)});
+  if (pending_.size() == 1 || pending_bytes_ >= kBatchBytes) {
+    wake_.notify_one();
+  }
+}
+
+void ShardSink::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      break;
+    }
+
+    // Give the batch time to grow, unless it is large enough already.
+    wake_.wait_for(lock, kBatchDelay,
+                   [this] { return stopping_ || pending_bytes_ >= kBatchBytes; });
+    std::vector<Entry> batch;
+    batch.swap(pending_);
+    pending_bytes_ = 0;
+    lock.unlock();
+    space_.notify_all();
+    WriteBatch(batch);
+    lock.lock();
+  }
+  lock.unlock();
+
+  if (shard_fd_ >= 0) {
+    CloseShard();
+  }
+}
+
+void ShardSink::WriteBatch(std::vector<Entry>& batch) {
+  std::vector<ResultLocator> locators(batch.size());
+  std::vector<bool> written(batch.size(), false);
+  std::vector<bool> rejected(batch.size(), false);
+  std::size_t first_buffered = 0;
+  const auto flush = [&](std::size_t end) {
+    const bool ok = FlushBuffer();
+    std::fill(written.begin() + first_buffered, written.begin() + end, ok);
+    first_buffered = end;
+  };
+
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    const auto& entry = batch[i];
+    if (entry.name.size() > kMaxNameSize) {
+      // The index must name the entry exactly as tar does, so it is not truncated.
+      rejected[i] = true;
+      continue;
+    }
+
+    const std::uint64_t entry_size = kBlockSize + PaddedSize(entry.data.size());
+    const std::uint64_t shard_bytes = shard_written_ + buffer_.size();
+    if (shard_fd_ >= 0 && shard_bytes > 0 &&
+        shard_bytes + entry_size + kTrailerSize > shard_size_) {
+      flush(i);
+      CloseShard();
+    }
+    if (shard_fd_ < 0 && !OpenShard()) {
+      first_buffered = i + 1;
+      continue;
+    }
+
+    const std::uint64_t offset = shard_written_ + buffer_.size() + kBlockSize;
+    locators[i] = {shard_path_.string(), offset, entry.data.size()};
+    AppendTarHeader(buffer_, entry.name, entry.data.size());
+    buffer_.insert(buffer_.end(), entry.data.begin(), entry.data.end());
+    buffer_.resize(buffer_.size() + PaddedSize(entry.data.size()) - entry.data.size());
+    buffered_index_ += entry.name + ' ' + std::to_string(offset) + ' ' +
+                       std::to_string(entry.data.size()) + '\n';
+  }
+  flush(batch.size());
+
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    batch[i].done(written[i] && !rejected[i] ? ImageProcessingError::kNoError
+                                             : ImageProcessingError::kImageSaveError,
+                  locators[i]);
+  }
+}
+
+bool ShardSink::FlushBuffer() {
+  if (buffer_.empty()) {
+    return true;
+  }
+
+  // The trailer goes out with every batch, so the shard is a complete archive between
+  // batches; the next batch overwrites it.
+  const std::size_t size = buffer_.size();
+  buffer_.resize(size + kTrailerSize);
+  const auto* index = reinterpret_cast<const unsigned char*>(buffered_index_.data());
+  const bool ok =
+      WriteAt(shard_fd_, buffer_.data(), buffer_.size(), shard_written_) &&
+      WriteAt(index_fd_, index, buffered_index_.size(), index_written_);
+  if (ok) {
+    shard_written_ += size;
+    index_written_ += buffered_index_.size();
+  }
+  // After a failed write the next batch goes to the same offsets again.
+  buffer_.clear();
+  buffered_index_.clear();
+  return ok;
+}
+
+bool ShardSink::OpenShard() {
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  while (true) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "shard-%06llu.tar",
+                  static_cast<unsigned long long>(next_shard_id_++));
+    shard_path_ = directory_ / name;
+    shard_fd_ = open(shard_path_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (shard_fd_ >= 0) {
+      break;
+    }
+    if (errno != EEXIST) {
+      shard_path_.clear();
+      return false;
+    }
+  }
+
+  const std::string index_path = shard_path_.string() + ".idx";
+  index_fd_ = open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (index_fd_ < 0) {
+    close(shard_fd_);
+    shard_fd_ = -1;
+    std::error_code ignored;
+    std::filesystem::remove(shard_path_, ignored);
+    shard_path_.clear();
+    return false;
+  }
+  shard_written_ = 0;
+  index_written_ = 0;
+  return true;
+}
+
+void ShardSink::CloseShard() {
+  // Two zero blocks end the archive; anything a failed write left behind is cut off.
+  // The entries have been reported already, so a failure here cannot be reported.
+  const unsigned char trailer[kTrailerSize] = {};
+  if (WriteAt(shard_fd_, trailer, kTrailerSize, shard_written_)) {
+    ftruncate(shard_fd_, static_cast<off_t>(shard_written_ + kTrailerSize));
+  }
+  fdatasync(shard_fd_);
+  close(shard_fd_);
+  shard_fd_ = -1;
+
+  ftruncate(index_fd_, static_cast<off_t>(index_written_));
+  fdatasync(index_fd_);
+  close(index_fd_);
+  index_fd_ = -1;
+
+  // Makes the names of the shard and its index durable too.
+  const int directory_fd =
+      open(directory_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (directory_fd >= 0) {
+    fsync(directory_fd);
+    close(directory_fd);
+  }
+
+  shard_path_.clear();
+}
+
+} // namespace image_processor
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <image_processor/error.hpp>
+#include <image_processor/result_locator.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @class ShardSink
+ * @brief Packs encoded results into large tar files instead of writing a file per result.
+ *
+ * Results are appended to shard-NNNNNN.tar in the output directory, each as a tar entry
+ * named after its task. Shards are plain ustar archives that tar can list and extract.
+ * Once a shard reaches the shard size, it is completed and a new one is started. Next to
+ * each shard, shard-NNNNNN.tar.idx lists every entry as "name offset length" lines, with
+ * the offset of the entry's data in the shard.
+ *
+ * Appends are collected in memory and written by a background thread in batches, one
+ * write per batch, at most 10 ms after the first append of the batch. Each batch ends
+ * with the tar trailer and appends its lines to the index, so after a crash both still
+ * cover every result reported so far, up to what the page cache had not written back. A
+ * result is only reported once it is written, so its locator can be read right away.
+ * Each shard and its index are synced once, when the shard is completed, instead of once
+ * per image.
+ */
+class ShardSink {
+public:
+  /**
+   * @brief Called once a result has been written, or could not be.
+   *
+   * Runs on the sink's thread; the locator is only valid with kNoError.
+   */
+  using Callback = std::function<void(ImageProcessingError, const ResultLocator&)>;
+
+  /**
+   * @param directory Directory the shards are written to.
+   * @param shard_size Size after which a shard is completed and a new one started.
+   */
+  ShardSink(const std::filesystem::path& directory, std::uint64_t shard_size);
+
+  /**
+   * @brief Writes what is still pending and completes the current shard.
+   */
+  ~ShardSink();
+
+  ShardSink(const ShardSink&) = delete;
+  ShardSink& operator=(const ShardSink&) = delete;
+
+  /**
+   * @brief Queues an encoded result for the next batch.
+   *
+   * @param name Name of the tar entry; longer than 100 bytes fails with kImageSaveError.
+   * @param data Encoded image.
+   * @param done Called once the result is written.
+   */
+  void Append(std::string name, std::vector<unsigned char> data, Callback done);
+
+private:
+  /**
+   * @struct Entry
+   * @brief A result waiting to be written.
+   */
+  struct Entry {
+    std::string name;
+    std::vector<unsigned char> data;
+    Callback done;
+  };
+
+  /**
+   * @brief Sink thread: writes a batch when it is large or old enough.
+   */
+  void Run();
+
+  /**
+   * @brief Writes a batch to the current shard, rotating shards as they fill up, then
+   * reports every entry of the batch.
+   */
+  void WriteBatch(std::vector<Entry>& batch);
+
+  /**
+   * @brief Writes and empties the buffer of the current shard and the matching index
+   * lines.
+   */
+  bool FlushBuffer();
+
+  /**
+   * @brief Starts the next shard whose name is not taken yet, and its index.
+   */
+  bool OpenShard();
+
+  /**
+   * @brief Writes the tar trailer, syncs the shard and its index.
+   */
+  void CloseShard();
+
+  const std::filesystem::path directory_;
+  const std::uint64_t shard_size_;
+
+  /**
+   * @brief Guards pending_, pending_bytes_ and stopping_.
+   */
+  std::mutex mutex_;
+  std::condition_variable wake_;  ///< Wakes the sink thread.
+  std::condition_variable space_; ///< Wakes appenders waiting for pending bytes to drop.
+  std::vector<Entry> pending_;
+  std::size_t pending_bytes_;
+  bool stopping_;
+
+  // Only used by the sink thread.
+  std::uint64_t next_shard_id_;
+  std::filesystem::path shard_path_;  ///< Current shard, empty if none is open.
+  int shard_fd_;                      ///< Descriptor of the current shard, -1 if none.
+  std::uint64_t shard_written_;       ///< Bytes written to the current shard.
+  std::vector<unsigned char> buffer_; ///< Entries of the batch not written yet.
+  std::string buffered_index_;        ///< Index lines of the entries in buffer_.
+  int index_fd_;                      ///< Descriptor of the current shard's index.
+  std::uint64_t index_written_;       ///< Bytes written to the current shard's index.
+
+  std::thread thread_;
+};
+
+} // namespace image_processor
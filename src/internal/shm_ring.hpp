@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace image_processor {
+
+/**
+ * @class ShmRing
+ * @brief Lock-free single-producer/single-consumer ring buffer that can live in memory
+ * shared between processes.
+ *
+ * The ring has no pointers and no constructor logic beyond zeroing its indices, so it can
+ * be placement-constructed in a shared mapping and used from any process that maps it.
+ * A producer that dies between writing a slot and publishing it leaves nothing visible to
+ * the consumer, which makes the ring safe to reuse after Reset() once the peer is gone.
+ *
+ * @tparam T Trivially copyable element type.
+ * @tparam Capacity Number of slots.
+ */
+template <typename T, std::size_t Capacity>
+class ShmRing {
+  static_assert(std::is_trivially_copyable_v<T>, "ShmRing elements are copied bytewise");
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "Cross-process rings need address-free atomics");
+
+public:
+  ShmRing() { Reset(); }
+
+  /**
+   * @brief Empties the ring. Only safe while neither peer is using it.
+   */
+  void Reset() {
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_release);
+  }
+
+  /**
+   * @brief Appends an element. Must only be called by the producer.
+   *
+   * @return false if the ring is full.
+   */
+  bool TryPush(const T& value) {
+    const std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+
+    slots_[tail % Capacity] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Removes the oldest element. Must only be called by the consumer.
+   *
+   * @return false if the ring is empty.
+   */
+  bool TryPop(T& value) {
+    const std::uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    value = slots_[head % Capacity];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Returns the number of elements currently in the ring.
+   */
+  std::size_t Size() const {
+    return static_cast<std::size_t>(tail_.load(std::memory_order_acquire) -
+                                    head_.load(std::memory_order_acquire));
+  }
+
+private:
+  alignas(64) std::atomic<std::uint64_t> head_;
+  alignas(64) std::atomic<std::uint64_t> tail_;
+  alignas(64) T slots_[Capacity];
+};
+
+} // namespace image_processor
@@ -0,0 +1,416 @@
+#include "strip_codec.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <png.h>
+
+namespace image_processor {
+
+namespace {
+
+/**
+ * @brief Quality cv::imwrite uses for JPEG unless told otherwise.
+ */
+constexpr int kJpegQuality = 95;
+
+/**
+ * @brief zlib level cv::imwrite uses for PNG unless told otherwise.
+ */
+constexpr int kPngCompressionLevel = 1;
+
+enum class Format { kUnknown, kJpeg, kPng };
+
+Format FormatOf(const std::string& path) {
+  const auto dot = path.rfind('.');
+  if (dot == std::string::npos) {
+    return Format::kUnknown;
+  }
+
+  std::string extension = path.substr(dot);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  if (extension == ".jpg" || extension == ".jpeg") {
+    return Format::kJpeg;
+  }
+  return extension == ".png" ? Format::kPng : Format::kUnknown;
+}
+
+// libjpeg and libpng report errors by longjmp-ing out of the failing call. Every setjmp
+// below guards plain C calls only, with no C++ object constructed in between.
+
+struct JpegError {
+  jpeg_error_mgr manager;
+  std::jmp_buf jump;
+};
+
+void JpegErrorExit(j_common_ptr info) {
+  std::longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+}
+
+void JpegOutputMessage(j_common_ptr) {}
+
+/**
+ * @brief Returns the EXIF orientation saved with the image's APP1 marker, 1 if none.
+ */
+int ExifOrientation(const jpeg_decompress_struct& info) {
+  for (jpeg_saved_marker_ptr marker = info.marker_list; marker != nullptr;
+       marker = marker->next) {
+    const JOCTET* data = marker->data;
+    const std::size_t size = marker->data_length;
+    if (marker->marker != JPEG_APP0 + 1 || size < 14 ||
+        std::memcmp(data, "Exif\0\0", 6) != 0) {
+      continue;
+    }
+
+    const JOCTET* tiff = data + 6;
+    const std::size_t tiff_size = size - 6;
+    const bool little_endian = tiff[0] == 'I';
+    const auto read16 = [&](std::size_t at) -> unsigned {
+      return little_endian ? tiff[at] | tiff[at + 1] << 8 : tiff[at] << 8 | tiff[at + 1];
+    };
+    const auto read32 = [&](std::size_t at) -> std::size_t {
+      return little_endian ? read16(at) | static_cast<std::size_t>(read16(at + 2)) << 16
+                           : static_cast<std::size_t>(read16(at)) << 16 | read16(at + 2);
+    };
+
+    const std::size_t ifd = read32(4);
+    if (ifd + 2 > tiff_size) {
+      return 1;
+    }
+    const unsigned entries = read16(ifd);
+    for (unsigned i = 0; i < entries; ++i) {
+      const std::size_t entry = ifd + 2 + i * 12;
+      if (entry + 12 > tiff_size) {
+        break;
+      }
+      if (read16(entry) == 0x0112) {
+        return static_cast<int>(read16(entry + 8));
+      }
+    }
+    return 1;
+  }
+  return 1;
+}
+
+class JpegDecoder : public StripDecoder {
+public:
+  ~JpegDecoder() override {
+    jpeg_destroy_decompress(&info_);
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  bool Open(const std::string& path) {
+    info_.err = jpeg_std_error(&error_.manager);
+    error_.manager.error_exit = JpegErrorExit;
+    error_.manager.output_message = JpegOutputMessage;
+    jpeg_create_decompress(&info_);
+
+    file_ = std::fopen(path.c_str(), "rb");
+    if (file_ == nullptr) {
+      return false;
+    }
+    if (setjmp(error_.jump) != 0) {
+      return false;
+    }
+
+    jpeg_stdio_src(&info_, file_);
+    jpeg_save_markers(&info_, JPEG_APP0 + 1, 0xFFFF);
+    jpeg_read_header(&info_, TRUE);
+    if (ExifOrientation(info_) > 1) {
+      return false; // cv::imread would rotate the whole image.
+    }
+    if (info_.jpeg_color_space != JCS_YCbCr && info_.jpeg_color_space != JCS_RGB) {
+      return false; // Not every libjpeg converts grayscale or CMYK to BGR.
+    }
+
+#ifdef JCS_EXTENSIONS
+    info_.out_color_space = JCS_EXT_BGR;
+#else
+    info_.out_color_space = JCS_RGB;
+#endif
+    // Decompression, and with it the coefficient buffer of a progressive image, only
+    // starts with the first ReadRows(), once the caller has decided to stream.
+    jpeg_calc_output_dimensions(&info_);
+    width_ = static_cast<int>(info_.output_width);
+    height_ = static_cast<int>(info_.output_height);
+    return true;
+  }
+
+  bool ReadRows(cv::Mat& rows, int count) override {
+    count = std::min<int>(count, height_ - static_cast<int>(info_.output_scanline));
+    rows.create(count, width_, CV_8UC3);
+    if (setjmp(error_.jump) != 0) {
+      return false;
+    }
+
+    if (!started_) {
+      jpeg_start_decompress(&info_);
+      started_ = true;
+    }
+    for (int y = 0; y < count; ++y) {
+      JSAMPROW row = rows.ptr<JSAMPLE>(y);
+      jpeg_read_scanlines(&info_, &row, 1);
+    }
+#ifndef JCS_EXTENSIONS
+    cv::cvtColor(rows, rows, cv::COLOR_RGB2BGR);
+#endif
+    return true;
+  }
+
+private:
+  jpeg_decompress_struct info_{};
+  JpegError error_{};
+  std::FILE* file_ = nullptr;
+  bool started_ = false;
+};
+
+class JpegEncoder : public StripEncoder {
+public:
+  ~JpegEncoder() override {
+    jpeg_destroy_compress(&info_);
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  bool Create(const std::string& path, int width, int height) {
+    info_.err = jpeg_std_error(&error_.manager);
+    error_.manager.error_exit = JpegErrorExit;
+    error_.manager.output_message = JpegOutputMessage;
+    jpeg_create_compress(&info_);
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+      return false;
+    }
+    if (setjmp(error_.jump) != 0) {
+      return false;
+    }
+
+    jpeg_stdio_dest(&info_, file_);
+    info_.image_width = static_cast<JDIMENSION>(width);
+    info_.image_height = static_cast<JDIMENSION>(height);
+    info_.input_components = 3;
+#ifdef JCS_EXTENSIONS
+    info_.in_color_space = JCS_EXT_BGR;
+#else
+    info_.in_color_space = JCS_RGB;
+#endif
+    jpeg_set_defaults(&info_);
+    jpeg_set_quality(&info_, kJpegQuality, TRUE);
+    jpeg_start_compress(&info_, TRUE);
+    return true;
+  }
+
+  bool WriteRows(const cv::Mat& rows) override {
+#ifdef JCS_EXTENSIONS
+    const cv::Mat& pixels = rows;
+#else
+    cv::Mat pixels;
+    cv::cvtColor(rows, pixels, cv::COLOR_BGR2RGB);
+#endif
+    if (setjmp(error_.jump) != 0) {
+      return false;
+    }
+
+    for (int y = 0; y < pixels.rows; ++y) {
+      JSAMPROW row = const_cast<JSAMPLE*>(pixels.ptr<JSAMPLE>(y));
+      jpeg_write_scanlines(&info_, &row, 1);
+    }
+    return true;
+  }
+
+  bool Finish() override {
+    if (setjmp(error_.jump) != 0) {
+      return false;
+    }
+
+    jpeg_finish_compress(&info_);
+    const bool closed = std::fclose(file_) == 0;
+    file_ = nullptr;
+    return closed;
+  }
+
+private:
+  jpeg_compress_struct info_{};
+  JpegError error_{};
+  std::FILE* file_ = nullptr;
+};
+
+void PngWarning(png_structp, png_const_charp) {}
+
+class PngDecoder : public StripDecoder {
+public:
+  ~PngDecoder() override {
+    if (png_ != nullptr) {
+      png_destroy_read_struct(&png_, &info_, nullptr);
+    }
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  bool Open(const std::string& path) {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (file_ == nullptr) {
+      return false;
+    }
+
+    png_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, PngWarning);
+    info_ = png_ != nullptr ? png_create_info_struct(png_) : nullptr;
+    if (info_ == nullptr) {
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png_)) != 0) {
+      return false;
+    }
+
+    png_init_io(png_, file_);
+    png_read_info(png_, info_);
+    if (png_get_interlace_type(png_, info_) != PNG_INTERLACE_NONE) {
+      return false; // Rows of an interlaced image are only final after the last pass.
+    }
+
+    // The conversions cv::imread applies for IMREAD_COLOR.
+    png_set_expand(png_);
+    png_set_strip_16(png_);
+    png_set_strip_alpha(png_);
+    png_set_gray_to_rgb(png_);
+    png_set_bgr(png_);
+    png_read_update_info(png_, info_);
+
+    width_ = static_cast<int>(png_get_image_width(png_, info_));
+    height_ = static_cast<int>(png_get_image_height(png_, info_));
+    return png_get_rowbytes(png_, info_) == static_cast<std::size_t>(width_) * 3;
+  }
+
+  bool ReadRows(cv::Mat& rows, int count) override {
+    count = std::min(count, height_ - next_row_);
+    rows.create(count, width_, CV_8UC3);
+    if (setjmp(png_jmpbuf(png_)) != 0) {
+      return false;
+    }
+
+    for (int y = 0; y < count; ++y) {
+      png_read_row(png_, rows.ptr<png_byte>(y), nullptr);
+    }
+    next_row_ += count;
+    return true;
+  }
+
+private:
+  png_structp png_ = nullptr;
+  png_infop info_ = nullptr;
+  std::FILE* file_ = nullptr;
+  int next_row_ = 0;
+};
+
+class PngEncoder : public StripEncoder {
+public:
+  ~PngEncoder() override {
+    if (png_ != nullptr) {
+      png_destroy_write_struct(&png_, &info_);
+    }
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  bool Create(const std::string& path, int width, int height) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+      return false;
+    }
+
+    png_ = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, PngWarning);
+    info_ = png_ != nullptr ? png_create_info_struct(png_) : nullptr;
+    if (info_ == nullptr) {
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png_)) != 0) {
+      return false;
+    }
+
+    png_init_io(png_, file_);
+    png_set_compression_level(png_, kPngCompressionLevel);
+    png_set_IHDR(png_, info_, static_cast<png_uint_32>(width),
+                 static_cast<png_uint_32>(height), 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_, info_);
+    png_set_bgr(png_);
+    return true;
+  }
+
+  bool WriteRows(const cv::Mat& rows) override {
+    if (setjmp(png_jmpbuf(png_)) != 0) {
+      return false;
+    }
+
+    for (int y = 0; y < rows.rows; ++y) {
+      png_write_row(png_, rows.ptr<png_byte>(y));
+    }
+    return true;
+  }
+
+  bool Finish() override {
+    if (setjmp(png_jmpbuf(png_)) != 0) {
+      return false;
+    }
+
+    png_write_end(png_, info_);
+    const bool closed = std::fclose(file_) == 0;
+    file_ = nullptr;
+    return closed;
+  }
+
+private:
+  png_structp png_ = nullptr;
+  png_infop info_ = nullptr;
+  std::FILE* file_ = nullptr;
+};
+
+} // namespace
+
+std::unique_ptr<StripDecoder> StripDecoder::Open(const std::string& path) {
+  switch (FormatOf(path)) {
+  case Format::kJpeg: {
+    auto decoder = std::make_unique<JpegDecoder>();
+    return decoder->Open(path) ? std::move(decoder) : nullptr;
+  }
+  case Format::kPng: {
+    auto decoder = std::make_unique<PngDecoder>();
+    return decoder->Open(path) ? std::move(decoder) : nullptr;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+std::unique_ptr<StripEncoder> StripEncoder::Create(const std::string& path, int width,
+                                                   int height) {
+  switch (FormatOf(path)) {
+  case Format::kJpeg: {
+    auto encoder = std::make_unique<JpegEncoder>();
+    return encoder->Create(path, width, height) ? std::move(encoder) : nullptr;
+  }
+  case Format::kPng: {
+    auto encoder = std::make_unique<PngEncoder>();
+    return encoder->Create(path, width, height) ? std::move(encoder) : nullptr;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+} // namespace image_processor
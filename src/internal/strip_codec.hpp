@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace cv {
+class Mat;
+} // namespace cv
+
+namespace image_processor {
+
+/**
+ * @class StripDecoder
+ * @brief Decodes a JPEG or PNG image top to bottom, a few rows at a time.
+ *
+ * Only the rows asked for are held in memory, on top of the codec's own state. Rows are
+ * decoded to 8-bit BGR, exactly like cv::imread with IMREAD_COLOR, so a streamed image
+ * matches a fully decoded one. Images that cv::imread would transform as a whole (a JPEG
+ * with an EXIF orientation, an interlaced PNG) cannot be streamed.
+ */
+class StripDecoder {
+public:
+  /**
+   * @brief Opens an image and reads its header.
+   *
+   * @param path Path of a .jpg, .jpeg or .png image.
+   * @return The decoder, or null if the image is missing, malformed or cannot be
+   * streamed.
+   */
+  static std::unique_ptr<StripDecoder> Open(const std::string& path);
+
+  virtual ~StripDecoder() = default;
+
+  int Width() const { return width_; }
+  int Height() const { return height_; }
+
+  /**
+   * @brief Decodes the next rows.
+   *
+   * @param rows Receives min(count, remaining) rows as CV_8UC3.
+   * @param count Number of rows to decode.
+   * @return false if the image data is corrupt.
+   */
+  virtual bool ReadRows(cv::Mat& rows, int count) = 0;
+
+protected:
+  int width_ = 0;
+  int height_ = 0;
+};
+
+/**
+ * @class StripEncoder
+ * @brief Encodes a JPEG or PNG image top to bottom, a few rows at a time, with the same
+ * settings as cv::imwrite's defaults.
+ */
+class StripEncoder {
+public:
+  /**
+   * @brief Creates the output file and writes its header.
+   *
+   * @param path Path of the image; the extension selects the format.
+   * @param width Width of the image.
+   * @param height Height of the image.
+   * @return The encoder, or null if the format is not supported or the file cannot be
+   * created.
+   */
+  static std::unique_ptr<StripEncoder> Create(const std::string& path, int width,
+                                              int height);
+
+  virtual ~StripEncoder() = default;
+
+  /**
+   * @brief Encodes the next rows.
+   *
+   * @param rows Rows as CV_8UC3, as wide as the image.
+   * @return false if writing failed.
+   */
+  virtual bool WriteRows(const cv::Mat& rows) = 0;
+
+  /**
+   * @brief Completes the image once every row has been written, and closes the file.
+   *
+   * @return false if writing failed.
+   */
+  virtual bool Finish() = 0;
+};
+
+} // namespace image_processor
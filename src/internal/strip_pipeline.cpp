@@ -0,0 +1,221 @@
+#include "strip_pipeline.hpp"
+
+#include <lib1/filters/blur.h>
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace image_processor {
+
+namespace {
+
+/**
+ * @brief Rows decoded per strip: a multiple of the tallest JPEG MCU, small enough that a
+ * strip of a 30000-pixel-wide image stays below 6 MB.
+ */
+constexpr int kStripRows = 64;
+
+/**
+ * @class RowStage
+ * @brief One stage of a streamed chain: receives the rows of its input top to bottom and
+ * passes the rows of its output on to the next stage as soon as they are final.
+ */
+class RowStage {
+public:
+  virtual ~RowStage() = default;
+
+  void Connect(RowStage* next) { next_ = next; }
+
+  /**
+   * @brief Consumes the next rows of the input.
+   *
+   * @return false if the output could not be written.
+   */
+  virtual bool Push(const cv::Mat& rows) = 0;
+
+  /**
+   * @brief Outputs the remaining rows once the whole input has been pushed.
+   *
+   * @return false if the output could not be written.
+   */
+  virtual bool Finish() { return next_->Finish(); }
+
+protected:
+  RowStage* next_ = nullptr;
+};
+
+/**
+ * @brief Forwards the rows inside the crop rectangle.
+ */
+class CropStage : public RowStage {
+public:
+  explicit CropStage(const cv::Rect& rect) : rect_(rect) {}
+
+  bool Push(const cv::Mat& rows) override {
+    const int first = next_row_;
+    next_row_ += rows.rows;
+    const int begin = std::max(first, rect_.y);
+    const int end = std::min(next_row_, rect_.y + rect_.height);
+    if (begin >= end) {
+      return true;
+    }
+
+    return next_->Push(rows(cv::Range(begin - first, end - first),
+                            cv::Range(rect_.x, rect_.x + rect_.width)));
+  }
+
+private:
+  const cv::Rect rect_;
+  int next_row_ = 0;
+};
+
+/**
+ * @brief Blurs batches of rows with lib1::blur, each with half a kernel of real rows
+ * above and below it. The library only applies its border at the top and bottom of the
+ * strip it is given, which are the image's own edges or rows this stage does not output.
+ */
+class BlurStage : public RowStage {
+public:
+  BlurStage(int kernel_size, int height)
+      : kernel_size_(kernel_size), halo_(kernel_size / 2), height_(height) {}
+
+  bool Push(const cv::Mat& rows) override {
+    window_.push_back(rows);
+    const int available = window_first_ + window_.rows;
+    if (available - next_row_ < kStripRows + halo_) {
+      return true;
+    }
+    return Flush(available - halo_);
+  }
+
+  bool Finish() override {
+    return (next_row_ >= height_ || Flush(height_)) && next_->Finish();
+  }
+
+private:
+  /**
+   * @brief Outputs rows up to @p end and drops the rows no later output needs.
+   */
+  bool Flush(int end) {
+    const int strip_begin = std::max(0, next_row_ - halo_);
+    const int strip_end = std::min(height_, end + halo_);
+    cv::Mat strip =
+        window_.rowRange(strip_begin - window_first_, strip_end - window_first_);
+    cv::Mat blurred;
+    lib1::blur(strip, blurred, cv::Size(kernel_size_, kernel_size_));
+    if (!next_->Push(blurred.rowRange(next_row_ - strip_begin, end - strip_begin))) {
+      return false;
+    }
+
+    next_row_ = end;
+    const int keep_from = std::max(window_first_, next_row_ - halo_);
+    window_ = window_.rowRange(keep_from - window_first_, window_.rows).clone();
+    window_first_ = keep_from;
+    return true;
+  }
+
+  const int kernel_size_;
+  const int halo_;
+  const int height_;
+  cv::Mat window_;       ///< Input rows [window_first_, window_first_ + window_.rows).
+  int window_first_ = 0;
+  int next_row_ = 0;     ///< First row not output yet.
+};
+
+/**
+ * @brief Last stage: hands rows to the encoder.
+ */
+class EncoderStage : public RowStage {
+public:
+  explicit EncoderStage(StripEncoder& encoder) : encoder_(encoder) {}
+
+  bool Push(const cv::Mat& rows) override { return encoder_.WriteRows(rows); }
+
+  bool Finish() override { return encoder_.Finish(); }
+
+private:
+  StripEncoder& encoder_;
+};
+
+} // namespace
+
+bool IsStreamable(const FilterChain& chain) {
+  return chain.IsValid() &&
+         std::all_of(chain.Steps().begin(), chain.Steps().end(),
+                     [](const PipelineStep& step) { return step.row_local; });
+}
+
+ImageProcessingError StreamImage(StripDecoder& decoder, const FilterChain& chain,
+                                 const std::string& output_path,
+                                 const std::function<bool()>& is_cancelled) {
+  std::vector<std::unique_ptr<RowStage>> stages;
+  cv::Size size(decoder.Width(), decoder.Height());
+  for (const auto& filter : chain.Filters()) {
+    const auto& params = filter.params;
+    switch (filter.type) {
+    case Filter::Type::Crop: {
+      const cv::Rect rect(params.crop.x, params.crop.y, params.crop.width,
+                          params.crop.height);
+      if (rect.empty() || (rect & cv::Rect(cv::Point(), size)) != rect) {
+        return ImageProcessingError::kProcessingFailed;
+      }
+      stages.push_back(std::make_unique<CropStage>(rect));
+      size = rect.size();
+      break;
+    }
+
+    case Filter::Type::Blur:
+      if (params.blur.kernel_size > 1) {
+        stages.push_back(
+            std::make_unique<BlurStage>(params.blur.kernel_size, size.height));
+      }
+      break;
+
+    default:
+      return ImageProcessingError::kInvalidFilter;
+    }
+  }
+
+  auto encoder = StripEncoder::Create(output_path, size.width, size.height);
+  if (!encoder) {
+    return ImageProcessingError::kImageSaveError;
+  }
+  stages.push_back(std::make_unique<EncoderStage>(*encoder));
+  for (std::size_t i = 0; i + 1 < stages.size(); ++i) {
+    stages[i]->Connect(stages[i + 1].get());
+  }
+
+  ImageProcessingError error = ImageProcessingError::kNoError;
+  cv::Mat strip;
+  for (int row = 0; row < decoder.Height(); row += strip.rows) {
+    if (is_cancelled && is_cancelled()) {
+      error = ImageProcessingError::kCancelled;
+      break;
+    }
+    if (!decoder.ReadRows(strip, kStripRows)) {
+      error = ImageProcessingError::kImageInaccessible;
+      break;
+    }
+    if (!stages.front()->Push(strip)) {
+      error = ImageProcessingError::kImageSaveError;
+      break;
+    }
+  }
+
+  if (error == ImageProcessingError::kNoError && !stages.front()->Finish()) {
+    error = ImageProcessingError::kImageSaveError;
+  }
+
+  if (error != ImageProcessingError::kNoError) {
+    encoder.reset();
+    std::error_code ignored;
+    std::filesystem::remove(output_path, ignored);
+  }
+  return error;
+}
+
+} // namespace image_processor
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "filter_chain.hpp"
+#include "strip_codec.hpp"
+#include <image_processor/error.hpp>
+
+#include <functional>
+#include <string>
+
+namespace image_processor {
+
+/**
+ * @brief Returns true if every step of the chain can run on horizontal strips.
+ */
+bool IsStreamable(const FilterChain& chain);
+
+/**
+ * @brief Applies a streamable chain to an image strip by strip, from decoder to encoder.
+ *
+ * Each filter becomes a stage that consumes rows from the previous one and passes rows on
+ * as soon as they are final: Crop forwards the part of each strip inside its rectangle,
+ * and Blur keeps half a kernel of rows around the rows it outputs. Both run the same
+ * kernels as the full-frame path, so a streamed result matches a fully decoded one. Peak
+ * memory is a few strips of the widest stage plus the kernel height, however tall the
+ * image is.
+ *
+ * @param decoder Decoder positioned at the first row of the input image.
+ * @param chain Streamable chain to apply.
+ * @param output_path Path of the output image; removed again if processing fails.
+ * @param is_cancelled Polled before every strip; may be empty.
+ * @return kNoError; kProcessingFailed if a crop does not fit the image;
+ * kImageInaccessible if the input is corrupt; kImageSaveError if the output cannot be
+ * written; or kCancelled.
+ */
+ImageProcessingError StreamImage(StripDecoder& decoder, const FilterChain& chain,
+                                 const std::string& output_path,
+                                 const std::function<bool()>& is_cancelled);
+
+} // namespace image_processor
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <vector>
 
-#include <image_processor/filter.hpp>
+#include "filter_chain.hpp"
+#include <image_processor/result_locator.hpp>
 
 namespace image_processor {
 
@@ -12,7 +14,9 @@ namespace image_processor {
  * @brief Represents an image processing task.
  *
  * A Task consists of a unique identifier, a path to the source image,
- * and an ordered list of operations (filters) to be applied to the image.
+ * and a shared, immutable chain of operations (filters) to be applied to the image.
+ * The tag and sequence number let CancelTasksWithTag() cancel every task submitted with a
+ * tag before the call, without tracking the tasks of each tag.
  */
 struct Task {
 
@@ -27,9 +31,37 @@ struct Task {
   std::string image;
 
   /**
-   * @brief An ordered list of operations (filters) to apply to the image.
+   * @brief The interned chain of operations (filters) to apply to the image.
    */
-  std::vector<Filter> operations;
+  std::shared_ptr<const FilterChain> operations;
+
+  /**
+   * @brief Tag the task was submitted with, empty if none.
+   */
+  std::string tag;
+
+  /**
+   * @brief Submission order, assigned by the CancellationRegistry.
+   */
+  std::uint64_t sequence = 0;
+};
+
+/**
+ * @struct TaskResult
+ * @brief Where the result of a successful task is stored, kept until it is retrieved.
+ *
+ * The result and its location form one record, so retrieving it can never separate them.
+ */
+struct TaskResult {
+  /**
+   * @brief File of the result. The offset and length are only set for a shard entry.
+   */
+  ResultLocator locator;
+
+  /**
+   * @brief True if the result is an entry of a shard rather than a file of its own.
+   */
+  bool in_shard = false;
 };
 
 } // namespace image_processor
@@ -0,0 +1,187 @@
+#include "task_codec.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace image_processor::task_codec {
+
+namespace {
+
+constexpr std::uint8_t kMaxFilterType = static_cast<std::uint8_t>(Filter::Type::Cartoonize);
+
+void PutVarint(std::uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void PutFloat(float value, std::string& out) {
+  char bytes[sizeof(float)];
+  std::memcpy(bytes, &value, sizeof(float));
+  out.append(bytes, sizeof(float));
+}
+
+void PutString(const std::string& value, std::string& out) {
+  PutVarint(value.size(), out);
+  out.append(value);
+}
+
+/**
+ * @brief Bounds-checked cursor over an encoded buffer.
+ *
+ * Every getter returns false once the input is exhausted, which makes truncated records
+ * (e.g. the unfinished tail of a spill segment) detectable without exceptions.
+ */
+class Reader {
+public:
+  Reader(const char* data, std::size_t size) : data_(data), end_(data + size) {}
+
+  bool GetVarint(std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (data_ == end_) {
+        return false;
+      }
+      const auto byte = static_cast<std::uint8_t>(*data_++);
+      value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename T>
+  bool GetVarint(T& value) {
+    std::uint64_t raw = 0;
+    if (!GetVarint(raw) || raw > std::numeric_limits<T>::max()) {
+      return false;
+    }
+    value = static_cast<T>(raw);
+    return true;
+  }
+
+  bool GetFloat(float& value) {
+    if (static_cast<std::size_t>(end_ - data_) < sizeof(float)) {
+      return false;
+    }
+    std::memcpy(&value, data_, sizeof(float));
+    data_ += sizeof(float);
+    return true;
+  }
+
+  bool GetString(std::string& value) {
+    std::uint64_t size = 0;
+    if (!GetVarint(size) || static_cast<std::uint64_t>(end_ - data_) < size) {
+      return false;
+    }
+    value.assign(data_, static_cast<std::size_t>(size));
+    data_ += size;
+    return true;
+  }
+
+  const char* Position() const { return data_; }
+
+private:
+  const char* data_;
+  const char* end_;
+};
+
+void EncodeFilter(const CompactFilter& filter, std::string& out) {
+  const auto& params = filter.params;
+  out.push_back(static_cast<char>(filter.type));
+  switch (filter.type) {
+  case Filter::Type::Resize:
+    PutVarint(params.resize.width, out);
+    PutVarint(params.resize.height, out);
+    break;
+  case Filter::Type::Crop:
+    PutVarint(params.crop.x, out);
+    PutVarint(params.crop.y, out);
+    PutVarint(params.crop.width, out);
+    PutVarint(params.crop.height, out);
+    break;
+  case Filter::Type::Blur:
+    PutVarint(params.blur.kernel_size, out);
+    break;
+  case Filter::Type::Watercolor:
+    PutFloat(params.watercolor.brush_size, out);
+    PutFloat(params.watercolor.brush_hardness, out);
+    PutFloat(params.watercolor.brush_strength, out);
+    break;
+  case Filter::Type::Cartoonize:
+    PutFloat(params.cartoonize.detalization_level, out);
+    break;
+  }
+}
+
+bool DecodeFilter(Reader& reader, CompactFilter& filter) {
+  std::uint8_t type = 0;
+  if (!reader.GetVarint(type) || type > kMaxFilterType) {
+    return false;
+  }
+
+  filter = CompactFilter{};
+  filter.type = static_cast<Filter::Type>(type);
+  auto& params = filter.params;
+  switch (filter.type) {
+  case Filter::Type::Resize:
+    return reader.GetVarint(params.resize.width) && reader.GetVarint(params.resize.height);
+  case Filter::Type::Crop:
+    return reader.GetVarint(params.crop.x) && reader.GetVarint(params.crop.y) &&
+           reader.GetVarint(params.crop.width) && reader.GetVarint(params.crop.height);
+  case Filter::Type::Blur:
+    return reader.GetVarint(params.blur.kernel_size);
+  case Filter::Type::Watercolor:
+    return reader.GetFloat(params.watercolor.brush_size) &&
+           reader.GetFloat(params.watercolor.brush_hardness) &&
+           reader.GetFloat(params.watercolor.brush_strength);
+  case Filter::Type::Cartoonize:
+    return reader.GetFloat(params.cartoonize.detalization_level);
+  }
+  return false;
+}
+
+} // namespace
+
+void EncodeTask(const Task& task, std::string& out) {
+  PutString(task.id, out);
+  PutString(task.image, out);
+  out.push_back(task.operations->IsValid() ? 1 : 0);
+  PutVarint(task.operations->Filters().size(), out);
+  for (const auto& filter : task.operations->Filters()) {
+    EncodeFilter(filter, out);
+  }
+  PutString(task.tag, out);
+  PutVarint(task.sequence, out);
+}
+
+std::size_t DecodeTask(const char* data, std::size_t size, Task& task) {
+  Reader reader(data, size);
+  std::uint8_t valid = 0;
+  std::uint64_t filter_count = 0;
+  if (!reader.GetString(task.id) || !reader.GetString(task.image) ||
+      !reader.GetVarint(valid) || !reader.GetVarint(filter_count) || filter_count > size) {
+    return 0;
+  }
+
+  std::vector<CompactFilter> filters(static_cast<std::size_t>(filter_count));
+  for (auto& filter : filters) {
+    if (!DecodeFilter(reader, filter)) {
+      return 0;
+    }
+  }
+  if (!reader.GetString(task.tag) || !reader.GetVarint(task.sequence)) {
+    return 0;
+  }
+
+  // Chains are interned again, so a refilled backlog shares them just like a fresh one.
+  task.operations = valid ? FilterChain::Intern(std::move(filters)) : FilterChain::Invalid();
+  return static_cast<std::size_t>(reader.Position() - data);
+}
+
+} // namespace image_processor::task_codec
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "task.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace image_processor::task_codec {
+
+/**
+ * @brief Appends the compact binary encoding of a task to a buffer.
+ *
+ * Strings are length-prefixed with a varint and each filter of the chain is written as
+ * its type followed by the parameters of that type only, so a typical task takes well
+ * under 100 bytes. The chain is interned again when the task is decoded.
+ *
+ * @param task Task to encode.
+ * @param out Buffer the encoding is appended to.
+ */
+void EncodeTask(const Task& task, std::string& out);
+
+/**
+ * @brief Decodes a task previously written by EncodeTask.
+ *
+ * @param data Start of the encoded task.
+ * @param size Number of bytes available at @p data.
+ * @param task Receives the decoded task.
+ * @return Number of bytes consumed, or 0 if the input is truncated or malformed.
+ */
+std::size_t DecodeTask(const char* data, std::size_t size, Task& task);
+
+} // namespace image_processor::task_codec
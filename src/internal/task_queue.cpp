@@ -0,0 +1,118 @@
+#include "task_queue.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace image_processor {
+
+namespace {
+
+constexpr std::size_t kMinRefillBatch = 256;
+
+} // namespace
+
+TaskQueue::TaskQueue()
+    : shards_(1), next_shard_(0), size_(0), spill_threshold_(0), spilling_(false) {}
+
+void TaskQueue::Reshard(std::size_t shard_count) {
+  std::vector<Task> pending;
+  for (auto& shard : shards_) {
+    Task task;
+    while (shard.try_pop(task)) {
+      pending.push_back(std::move(task));
+    }
+  }
+
+  shards_.clear();
+  shards_.resize(shard_count == 0 ? 1 : shard_count);
+  next_shard_.store(0);
+  size_.store(0);
+
+  for (auto& task : pending) {
+    PushToMemory(std::move(task));
+  }
+}
+
+void TaskQueue::ConfigureSpill(std::size_t threshold,
+                               const std::filesystem::path& directory) {
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  const bool drained = !spill_ || spill_->Size() == 0;
+  if (threshold == 0 && drained) {
+    spill_.reset();
+  } else if (threshold != 0 && (!spill_ || (drained && directory != spill_directory_))) {
+    spill_ = std::make_unique<TaskSpill>(directory);
+    spill_directory_ = directory;
+  }
+  spill_threshold_.store(threshold);
+}
+
+void TaskQueue::Push(Task task) {
+  const std::size_t threshold = spill_threshold_.load();
+  if (!spilling_.load() && (threshold == 0 || size_.load() < threshold)) {
+    PushToMemory(std::move(task));
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  const bool spill_empty = !spill_ || spill_->Size() == 0;
+  if (spill_empty && (threshold == 0 || size_.load() < threshold)) {
+    spilling_.store(false);
+    PushToMemory(std::move(task));
+    return;
+  }
+
+  spilling_.store(true);
+  if (!spill_->Append(task)) {
+    PushToMemory(std::move(task));
+  }
+}
+
+bool TaskQueue::TryPop(Task& task, std::size_t preferred_shard) {
+  if (spilling_.load() && size_.load() <= spill_threshold_.load() / 2) {
+    Refill();
+  }
+
+  const std::size_t shard_count = shards_.size();
+  for (std::size_t i = 0; i < shard_count; ++i) {
+    if (shards_[(preferred_shard + i) % shard_count].try_pop(task)) {
+      size_.fetch_sub(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::error_code TaskQueue::SpillError() {
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  return spill_ ? spill_->Error() : std::error_code();
+}
+
+void TaskQueue::PushToMemory(Task task) {
+  const std::size_t shard = next_shard_.fetch_add(1, std::memory_order_relaxed);
+  size_.fetch_add(1);
+  shards_[shard % shards_.size()].push(std::move(task));
+}
+
+void TaskQueue::Refill() {
+  std::unique_lock<std::mutex> lock(spill_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !spill_) {
+    return;
+  }
+
+  const std::size_t threshold = spill_threshold_.load();
+  const std::size_t size = size_.load();
+  const std::size_t room = std::max(threshold > size ? threshold - size : 0, kMinRefillBatch);
+
+  std::vector<Task> batch;
+  batch.reserve(std::min(room, spill_->Size()));
+  spill_->ReadBatch(batch, room);
+  for (auto& task : batch) {
+    PushToMemory(std::move(task));
+  }
+
+  if (spill_->Size() == 0) {
+    spilling_.store(false);
+  }
+}
+
+} // namespace image_processor
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "task.hpp"
+#include "task_spill.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <tbb/concurrent_queue.h>
+
+namespace image_processor {
+
+/**
+ * @class TaskQueue
+ * @brief A sharded, lock-free queue of pending tasks with optional spill to disk.
+ *
+ * Tasks are spread round-robin over the shards. Each worker pops from its preferred shard
+ * (its NUMA node's) first and only steals from the other shards when that one is empty,
+ * so no task can starve. With a single shard this is a plain tbb::concurrent_queue.
+ *
+ * When spilling is enabled and more than the threshold of tasks are queued in memory, new
+ * tasks are appended to a TaskSpill instead. Workers move them back into memory in FIFO
+ * order, in batches, whenever the in-memory part drops to half the threshold, so memory
+ * use stays flat however long the backlog grows. Pushes and pops that do not involve the
+ * spill stay lock-free. If the spill cannot be written and refuses a task, the task is
+ * queued in memory instead, ahead of the spilled ones, and SpillError() reports why.
+ */
+class TaskQueue {
+public:
+  /**
+   * @brief Constructs a queue with a single shard and spilling disabled.
+   */
+  TaskQueue();
+
+  /**
+   * @brief Changes the number of shards, keeping every queued task.
+   *
+   * Must not be called while other threads push or pop.
+   *
+   * @param shard_count New number of shards, at least 1.
+   */
+  void Reshard(std::size_t shard_count);
+
+  /**
+   * @brief Enables, disables or reconfigures spilling to disk.
+   *
+   * Tasks that are already spilled stay in the current spill, which keeps being used until
+   * it has drained.
+   *
+   * @param threshold Number of tasks kept in memory before new ones spill, 0 to disable.
+   * @param directory Directory for spill segment files.
+   * @throw std::system_error if the spill directory is not writable.
+   */
+  void ConfigureSpill(std::size_t threshold, const std::filesystem::path& directory);
+
+  /**
+   * @brief Enqueues a task.
+   *
+   * @param task Task to enqueue.
+   */
+  void Push(Task task);
+
+  /**
+   * @brief Dequeues a task, preferring the given shard.
+   *
+   * @param task Receives the dequeued task.
+   * @param preferred_shard Shard to try first; taken modulo the shard count.
+   * @return true if a task was dequeued, false if every shard was empty.
+   */
+  bool TryPop(Task& task, std::size_t preferred_shard);
+
+  /**
+   * @brief Returns the number of tasks queued in memory; spilled tasks are not counted.
+   *
+   * The value is a snapshot and may be stale by the time it is used.
+   */
+  std::size_t MemorySize() const { return size_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the error that lost spilled tasks, if any; otherwise that of the
+   * latest failed spill write, cleared once a write succeeds.
+   */
+  std::error_code SpillError();
+
+private:
+  /**
+   * @brief Pushes a task to one of the in-memory shards.
+   */
+  void PushToMemory(Task task);
+
+  /**
+   * @brief Moves a batch of spilled tasks back into memory.
+   *
+   * Only one thread refills at a time; others return immediately and keep popping.
+   */
+  void Refill();
+
+  /**
+   * @brief Per-shard queues. A deque keeps shard addresses stable across growth.
+   */
+  std::deque<tbb::concurrent_queue<Task>> shards_;
+
+  /**
+   * @brief Counter used to pick the shard of the next pushed task.
+   */
+  std::atomic<std::size_t> next_shard_;
+
+  /**
+   * @brief Number of tasks currently held in the in-memory shards.
+   */
+  std::atomic<std::size_t> size_;
+
+  /**
+   * @brief In-memory task count above which new tasks spill, 0 if spilling is disabled.
+   */
+  std::atomic<std::size_t> spill_threshold_;
+
+  /**
+   * @brief True while the spill holds tasks, so new ones must go behind them.
+   */
+  std::atomic<bool> spilling_;
+
+  /**
+   * @brief Guards spill_.
+   */
+  std::mutex spill_mutex_;
+
+  /**
+   * @brief Disk-backed overflow, null when spilling has never been enabled.
+   */
+  std::unique_ptr<TaskSpill> spill_;
+
+  /**
+   * @brief Directory of the current spill.
+   */
+  std::filesystem::path spill_directory_;
+};
+
+} // namespace image_processor
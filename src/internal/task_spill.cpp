@@ -0,0 +1,277 @@
+#include "task_spill.hpp"
+#include "task_codec.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace image_processor {
+
+namespace {
+
+constexpr std::size_t kWriteBufferBytes = 1 << 20;
+constexpr std::size_t kMaxWriteBufferBytes = 4 * kWriteBufferBytes;
+constexpr std::size_t kReadBufferBytes = 1 << 20;
+constexpr std::uint64_t kReadaheadBytes = 8 << 20;
+constexpr std::uint64_t kSegmentBytes = 64 << 20;
+
+void CloseFile(int& fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+} // namespace
+
+TaskSpill::TaskSpill(const std::filesystem::path& directory)
+    : directory_(directory), next_segment_id_(0), size_(0), write_fd_(-1),
+      write_buffer_tasks_(0), read_fd_(-1), read_offset_(0), readahead_offset_(0),
+      read_position_(0), read_buffer_from_segment_(true), lost_tasks_(0) {
+  std::filesystem::create_directories(directory_);
+  if (!OpenWriteSegment()) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Failed to create a task spill segment in " +
+                                directory_.string());
+  }
+}
+
+TaskSpill::~TaskSpill() {
+  CloseFile(read_fd_);
+  CloseFile(write_fd_);
+  std::error_code ignored;
+  for (const auto& segment : segments_) {
+    std::filesystem::remove(segment.path, ignored);
+  }
+}
+
+bool TaskSpill::Append(const Task& task) {
+  if (write_buffer_.size() >= kMaxWriteBufferBytes && !FlushWriteBuffer()) {
+    return false;
+  }
+
+  const std::size_t old_size = write_buffer_.size();
+  task_codec::EncodeTask(task, write_buffer_);
+  ++write_buffer_tasks_;
+  ++size_;
+
+  // After a failed write, wait for another buffer's worth before trying again.
+  const std::size_t flush_at = write_error_
+                                  ? (old_size / kWriteBufferBytes + 1) * kWriteBufferBytes
+                                  : kWriteBufferBytes;
+  if (write_buffer_.size() >= flush_at) {
+    FlushWriteBuffer();
+  }
+  return true;
+}
+
+std::size_t TaskSpill::ReadBatch(std::vector<Task>& tasks, std::size_t max_tasks) {
+  std::size_t read = 0;
+  while (read < max_tasks && size_ > 0) {
+    Task task;
+    const std::size_t consumed =
+        task_codec::DecodeTask(read_buffer_.data() + read_position_,
+                               read_buffer_.size() - read_position_, task);
+    if (consumed == 0) {
+      if (!FillReadBuffer()) {
+        // Only reachable if the bookkeeping is off; the tasks cannot be found anyway.
+        read_error_ = std::make_error_code(std::errc::io_error);
+        lost_tasks_ += size_;
+        size_ = 0;
+        break;
+      }
+      continue;
+    }
+
+    read_position_ += consumed;
+    if (read_buffer_from_segment_) {
+      ++segments_.front().tasks_read;
+    }
+    tasks.push_back(std::move(task));
+    --size_;
+    ++read;
+  }
+
+  if (size_ == 0) {
+    Reset();
+  }
+
+  return read;
+}
+
+bool TaskSpill::OpenWriteSegment() {
+  CloseFile(write_fd_);
+
+  const std::filesystem::path path =
+      directory_ / ("tasks_" + std::to_string(getpid()) + "_" +
+                    std::to_string(next_segment_id_++) + ".seg");
+  write_fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+  if (write_fd_ < 0) {
+    return false;
+  }
+
+  segments_.push_back({path, 0, 0, 0});
+  return true;
+}
+
+bool TaskSpill::FlushWriteBuffer() {
+  if (write_buffer_.empty()) {
+    return true;
+  }
+
+  if ((write_fd_ < 0 || segments_.back().size >= kSegmentBytes) && !OpenWriteSegment()) {
+    write_error_ = std::error_code(errno, std::generic_category());
+    return false;
+  }
+
+  std::size_t written = 0;
+  while (written < write_buffer_.size()) {
+    const ssize_t result =
+        write(write_fd_, write_buffer_.data() + written, write_buffer_.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      write_error_ =
+          std::error_code(result < 0 ? errno : ENOSPC, std::generic_category());
+      // Bytes past the segment's recorded size are never read. They are cut off so the
+      // next flush can append to the same segment, or else it starts a fresh one.
+      if (ftruncate(write_fd_, static_cast<off_t>(segments_.back().size)) != 0) {
+        CloseFile(write_fd_);
+      }
+      return false;
+    }
+    written += static_cast<std::size_t>(result);
+  }
+
+  segments_.back().size += written;
+  segments_.back().tasks += write_buffer_tasks_;
+  write_buffer_.clear();
+  write_buffer_tasks_ = 0;
+  write_error_.clear();
+  return true;
+}
+
+bool TaskSpill::FillReadBuffer() {
+  read_buffer_.erase(0, read_position_);
+  read_position_ = 0;
+
+  while (true) {
+    if (!segments_.empty() && read_offset_ >= segments_.front().size &&
+        read_buffer_from_segment_ && !read_buffer_.empty()) {
+      // Records never span segments, so bytes left at the end of one are a truncated or
+      // corrupted record.
+      DropFrontSegment(std::make_error_code(std::errc::illegal_byte_sequence));
+      continue;
+    }
+
+    if (segments_.empty() ||
+        (segments_.size() == 1 && read_offset_ >= segments_.front().size)) {
+      // The reader caught up with the writer: take the buffered records directly instead
+      // of writing them out just to read them back.
+      if (write_buffer_.empty()) {
+        return false;
+      }
+      read_buffer_.append(write_buffer_);
+      read_buffer_from_segment_ = false;
+      write_buffer_.clear();
+      write_buffer_tasks_ = 0;
+      return true;
+    }
+
+    const Segment& front = segments_.front();
+    if (read_offset_ >= front.size) {
+      // The front segment is fully consumed.
+      CloseFile(read_fd_);
+      std::error_code ignored;
+      std::filesystem::remove(front.path, ignored);
+      segments_.pop_front();
+      read_offset_ = 0;
+      readahead_offset_ = 0;
+      continue;
+    }
+
+    if (read_fd_ < 0) {
+      read_fd_ = open(front.path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (read_fd_ < 0) {
+        DropFrontSegment(std::error_code(errno, std::generic_category()));
+        continue;
+      }
+      posix_fadvise(read_fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    if (read_offset_ + kReadaheadBytes / 2 >= readahead_offset_) {
+      readahead_offset_ = std::max(readahead_offset_, read_offset_);
+      posix_fadvise(read_fd_, static_cast<off_t>(readahead_offset_),
+                    static_cast<off_t>(kReadaheadBytes), POSIX_FADV_WILLNEED);
+      readahead_offset_ += kReadaheadBytes;
+    }
+
+    const std::size_t chunk = static_cast<std::size_t>(
+        std::min<std::uint64_t>(kReadBufferBytes, front.size - read_offset_));
+    const std::size_t old_size = read_buffer_.size();
+    read_buffer_.resize(old_size + chunk);
+
+    ssize_t result;
+    do {
+      result = pread(read_fd_, read_buffer_.data() + old_size, chunk,
+                     static_cast<off_t>(read_offset_));
+    } while (result < 0 && errno == EINTR);
+
+    if (result <= 0) {
+      // Reading stops short of what was written: the file was truncated or failed.
+      read_buffer_.resize(old_size);
+      DropFrontSegment(
+          std::error_code(result < 0 ? errno : EIO, std::generic_category()));
+      continue;
+    }
+
+    read_buffer_.resize(old_size + static_cast<std::size_t>(result));
+    read_buffer_from_segment_ = true;
+    read_offset_ += static_cast<std::uint64_t>(result);
+    return true;
+  }
+}
+
+void TaskSpill::DropFrontSegment(std::error_code error) {
+  const Segment& front = segments_.front();
+  const std::size_t lost = front.tasks - front.tasks_read;
+  lost_tasks_ += lost;
+  size_ -= lost;
+  read_error_ = error;
+
+  read_buffer_.clear();
+  read_position_ = 0;
+  CloseFile(read_fd_);
+  if (segments_.size() == 1) {
+    // It is also the segment being written; the next flush starts a fresh one.
+    CloseFile(write_fd_);
+  }
+  std::error_code ignored;
+  std::filesystem::remove(front.path, ignored);
+  segments_.pop_front();
+  read_offset_ = 0;
+  readahead_offset_ = 0;
+}
+
+void TaskSpill::Reset() {
+  CloseFile(read_fd_);
+  CloseFile(write_fd_);
+  std::error_code ignored;
+  for (const auto& segment : segments_) {
+    std::filesystem::remove(segment.path, ignored);
+  }
+
+  segments_.clear();
+  write_buffer_.clear();
+  write_buffer_tasks_ = 0;
+  read_buffer_.clear();
+  read_buffer_from_segment_ = true;
+  read_position_ = 0;
+  read_offset_ = 0;
+  readahead_offset_ = 0;
+}
+
+} // namespace image_processor
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "task.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @class TaskSpill
+ * @brief FIFO overflow store for tasks, backed by append-only segment files.
+ *
+ * Tasks are encoded with task_codec into a write buffer that is appended to the current
+ * segment file once it fills up; segments are rotated at a fixed size and deleted as soon
+ * as they have been read back. Only the segment being read and the one being written are
+ * kept open. Nothing is ever fsync'ed: the spill only extends the in-memory queue, which
+ * does not survive a restart either.
+ *
+ * A segment that cannot be read back completely (deleted, truncated or corrupted) loses
+ * its remaining tasks. Their IDs are not known without reading them, so they are counted
+ * by LostTasks() and reported by Error(), and reading goes on with the next segment.
+ *
+ * The class is not thread-safe; TaskQueue serializes access to it.
+ */
+class TaskSpill {
+public:
+  /**
+   * @brief Creates a spill in the given directory.
+   *
+   * @param directory Directory for segment files. Created if it does not exist.
+   * @throw std::system_error if the first segment file cannot be created.
+   */
+  explicit TaskSpill(const std::filesystem::path& directory);
+
+  /**
+   * @brief Closes and deletes every segment file.
+   */
+  ~TaskSpill();
+
+  TaskSpill(const TaskSpill&) = delete;
+  TaskSpill& operator=(const TaskSpill&) = delete;
+
+  /**
+   * @brief Appends a task to the end of the spill.
+   *
+   * Usually only copies into the write buffer. If writing the buffer out fails (e.g. the
+   * disk is full) the data stays buffered in memory and the write is retried once the
+   * buffer is full again. The buffer is capped at a few times its usual size; past that,
+   * tasks are refused until a write succeeds, and the caller has to keep them.
+   *
+   * @param task Task to append.
+   * @return false if the task was refused.
+   */
+  bool Append(const Task& task);
+
+  /**
+   * @brief Reads tasks from the front of the spill in FIFO order.
+   *
+   * Tasks of unreadable segments are skipped and counted as lost.
+   *
+   * @param tasks Receives the tasks; existing content is kept.
+   * @param max_tasks Maximum number of tasks to read.
+   * @return Number of tasks read.
+   */
+  std::size_t ReadBatch(std::vector<Task>& tasks, std::size_t max_tasks);
+
+  /**
+   * @brief Returns the number of tasks appended but not yet read back.
+   */
+  std::size_t Size() const { return size_; }
+
+  /**
+   * @brief Returns the error that lost tasks, if any; otherwise the error of the latest
+   * failed write, cleared once a write succeeds.
+   */
+  std::error_code Error() const { return read_error_ ? read_error_ : write_error_; }
+
+  /**
+   * @brief Returns the number of tasks lost because their segment could not be read.
+   */
+  std::size_t LostTasks() const { return lost_tasks_; }
+
+private:
+  /**
+   * @brief A segment file, the bytes written to it so far and the tasks they hold.
+   */
+  struct Segment {
+    std::filesystem::path path;
+    std::uint64_t size;
+    std::size_t tasks;      ///< Tasks written to the segment.
+    std::size_t tasks_read; ///< Tasks decoded from the segment.
+  };
+
+  /**
+   * @brief Starts a new segment file at the back of the spill.
+   *
+   * @return false if the file could not be created.
+   */
+  bool OpenWriteSegment();
+
+  /**
+   * @brief Writes the write buffer to the back segment, rotating it when it is full.
+   *
+   * @return false if the data could not be written; it then stays buffered and
+   * write_error_ is set.
+   */
+  bool FlushWriteBuffer();
+
+  /**
+   * @brief Loads more bytes of the front segment into the read buffer.
+   *
+   * Switches to the next segment, or takes over the write buffer, when the front segment
+   * has been read completely. A front segment that cannot be read is dropped with
+   * DropFrontSegment().
+   *
+   * @return false if no more bytes are available.
+   */
+  bool FillReadBuffer();
+
+  /**
+   * @brief Deletes the front segment, counting the tasks not read from it as lost.
+   *
+   * @param error Why the rest of the segment cannot be read.
+   */
+  void DropFrontSegment(std::error_code error);
+
+  /**
+   * @brief Deletes every segment once the spill is empty, so disk use returns to zero.
+   */
+  void Reset();
+
+  std::filesystem::path directory_;
+  std::uint64_t next_segment_id_;
+  std::size_t size_;
+
+  std::deque<Segment> segments_;
+  int write_fd_;
+  std::string write_buffer_;
+  std::size_t write_buffer_tasks_;
+  std::error_code write_error_;
+
+  int read_fd_;
+  std::uint64_t read_offset_;
+  std::uint64_t readahead_offset_;
+  std::string read_buffer_;
+  std::size_t read_position_;
+  bool read_buffer_from_segment_; ///< False while it holds a taken-over write buffer.
+  std::error_code read_error_;
+  std::size_t lost_tasks_;
+};
+
+} // namespace image_processor
@@ -41,4 +41,37 @@ cv::Mat ConvertToCV(const SIPL::Image<float>& sipl_image) {
   return cv_image;
 }
 
+SIPL::Image<SIPL::color_float> ConvertToSIPLColor(const cv::Mat& cv_image) {
+  SIPL::Image<SIPL::color_float> sipl_image(cv_image.cols, cv_image.rows);
+
+  for (int i = 0; i < cv_image.rows; i++) {
+    const cv::Vec3b* row = cv_image.ptr<cv::Vec3b>(i);
+    for (int j = 0; j < cv_image.cols; j++) {
+      SIPL::color_float color;
+      color.red = row[j][2] / 255.0f;
+      color.green = row[j][1] / 255.0f;
+      color.blue = row[j][0] / 255.0f;
+      sipl_image.set(j, i, color);
+    }
+  }
+
+  return sipl_image;
+}
+
+cv::Mat ConvertToCV(const SIPL::Image<SIPL::color_float>& sipl_image) {
+  cv::Mat cv_image(sipl_image.getHeight(), sipl_image.getWidth(), CV_8UC3);
+
+  for (int i = 0; i < cv_image.rows; i++) {
+    cv::Vec3b* row = cv_image.ptr<cv::Vec3b>(i);
+    for (int j = 0; j < cv_image.cols; j++) {
+      const SIPL::color_float color = sipl_image.get(j, i);
+      row[j][0] = cv::saturate_cast<uchar>(color.blue * 255.0f);
+      row[j][1] = cv::saturate_cast<uchar>(color.green * 255.0f);
+      row[j][2] = cv::saturate_cast<uchar>(color.red * 255.0f);
+    }
+  }
+
+  return cv_image;
+}
+
 } // namespace image_processor::utils
\ No newline at end of file
@@ -45,4 +45,25 @@ SIPL::Image<float> ConvertToSIPL(const cv::Mat& cv_image);
  */
 cv::Mat ConvertToCV(const SIPL::Image<float>& sipl_image);
 
+/**
+ * @brief Converts a color cv::Mat image to SIPL::Image<SIPL::color_float>.
+ *
+ * The input cv::Mat should have three uchar channels in OpenCV's BGR order. The output
+ * SIPL image will contain red, green and blue values normalized in the range [0.0, 1.0].
+ *
+ * @param cv_image The OpenCV color image (CV_8UC3) to be converted.
+ * @return SIPL::Image<SIPL::color_float> The converted SIPL image.
+ */
+SIPL::Image<SIPL::color_float> ConvertToSIPLColor(const cv::Mat& cv_image);
+
+/**
+ * @brief Converts a SIPL::Image<SIPL::color_float> to cv::Mat.
+ *
+ * The input channels should be in the range [0.0, 1.0]; values outside it are clamped.
+ *
+ * @param sipl_image The SIPL color image to be converted.
+ * @return cv::Mat The converted OpenCV color image (CV_8UC3, BGR).
+ */
+cv::Mat ConvertToCV(const SIPL::Image<SIPL::color_float>& sipl_image);
+
 } // namespace image_processor::utils
\ No newline at end of file
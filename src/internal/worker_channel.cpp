@@ -0,0 +1,97 @@
+#include "worker_channel.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace image_processor {
+
+namespace {
+
+WorkerChannel* Map(int fd) {
+  void* address =
+      mmap(nullptr, sizeof(WorkerChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int error = errno;
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::system_error(error, std::generic_category(), "mmap worker channel");
+  }
+  return static_cast<WorkerChannel*>(address);
+}
+
+} // namespace
+
+SharedChannel SharedChannel::Create(const std::string& name, std::size_t worker_count) {
+  if (worker_count == 0 || worker_count > WorkerChannel::kMaxWorkers) {
+    throw std::invalid_argument("Worker process count must be between 1 and " +
+                                std::to_string(WorkerChannel::kMaxWorkers) + ".");
+  }
+
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+  }
+  if (ftruncate(fd, sizeof(WorkerChannel)) != 0) {
+    const int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+  }
+
+  // A fresh segment is zero-filled, so only the constructors of the rings need to run;
+  // value-initializing would touch every page of the unused slots.
+  WorkerChannel* channel = nullptr;
+  try {
+    channel = new (Map(fd)) WorkerChannel;
+  } catch (...) {
+    shm_unlink(name.c_str());
+    throw;
+  }
+
+  channel->worker_count = static_cast<std::uint32_t>(worker_count);
+  channel->shutdown.store(false);
+  std::atomic_thread_fence(std::memory_order_release);
+  channel->magic = WorkerChannel::kMagic;
+  return SharedChannel(name, channel, true);
+}
+
+SharedChannel SharedChannel::Attach(const std::string& name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+  }
+
+  WorkerChannel* channel = Map(fd);
+  if (channel->magic != WorkerChannel::kMagic) {
+    munmap(channel, sizeof(WorkerChannel));
+    throw std::runtime_error("Shared memory segment " + name +
+                             " is not a worker channel.");
+  }
+  return SharedChannel(name, channel, false);
+}
+
+SharedChannel::SharedChannel(std::string name, WorkerChannel* channel, bool owner)
+    : name_(std::move(name)), channel_(channel), owner_(owner) {}
+
+SharedChannel::SharedChannel(SharedChannel&& other) noexcept
+    : name_(std::move(other.name_)), channel_(other.channel_), owner_(other.owner_) {
+  other.channel_ = nullptr;
+  other.owner_ = false;
+}
+
+SharedChannel::~SharedChannel() {
+  if (channel_ == nullptr) {
+    return;
+  }
+
+  munmap(channel_, sizeof(WorkerChannel));
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+} // namespace image_processor
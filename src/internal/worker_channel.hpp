@@ -0,0 +1,188 @@
+#pragma once
+
+#include "shm_ring.hpp"
+#include <image_processor/error.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace image_processor {
+
+/**
+ * @struct WorkerRequest
+ * @brief A task sent to a worker process, encoded with task_codec::EncodeTask.
+ */
+struct WorkerRequest {
+  static constexpr std::size_t kMaxPayload = 8192; ///< Largest encoded task that fits.
+
+  std::uint64_t ticket;        ///< Identifies the dispatch; echoed in the response.
+  std::uint32_t size;          ///< Number of valid bytes in payload.
+  char payload[kMaxPayload];   ///< The encoded task.
+};
+
+/**
+ * @struct WorkerResponse
+ * @brief Outcome of a request, sent back by the worker process.
+ */
+struct WorkerResponse {
+  static constexpr std::size_t kMaxResult = 4096; ///< Longest result path that fits.
+
+  std::uint64_t ticket;           ///< Ticket of the request this answers.
+  ImageProcessingError error;     ///< kNoError if result holds the processed image path.
+  bool decoded;                   ///< kCancelled: false if the image was never decoded.
+  std::uint32_t skipped_filters;  ///< kCancelled: filters that were not applied.
+  std::uint32_t size;             ///< Number of valid bytes in result.
+  char result[kMaxResult];        ///< Path of the processed image.
+};
+
+/**
+ * @struct WorkerSlot
+ * @brief Shared state of one worker process: its rings and what it is working on.
+ */
+struct WorkerSlot {
+  static constexpr std::size_t kRingCapacity = 4; ///< Requests queued per worker at most.
+
+  ShmRing<WorkerRequest, kRingCapacity> requests;   ///< Supervisor to worker.
+  ShmRing<WorkerResponse, kRingCapacity> responses; ///< Worker to supervisor.
+
+  std::atomic<std::uint64_t> current_ticket; ///< Ticket being processed, 0 when idle.
+  std::atomic<std::uint64_t> started_ns;     ///< Monotonic time current_ticket started.
+
+  /**
+   * @brief Tickets cancelled by the supervisor, written round-robin. A ticket is written
+   * once, and at most kRingCapacity requests are queued, so no pending ticket is ever
+   * overwritten.
+   */
+  std::atomic<std::uint64_t> cancelled_tickets[kRingCapacity];
+
+  /**
+   * @brief Returns true if the supervisor cancelled the request with this ticket.
+   */
+  bool IsCancelled(std::uint64_t ticket) const {
+    for (const auto& cancelled : cancelled_tickets) {
+      if (cancelled.load(std::memory_order_relaxed) == ticket) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * @struct WorkerChannel
+ * @brief Layout of the shared-memory segment between the supervisor and its workers.
+ */
+struct WorkerChannel {
+  static constexpr std::uint32_t kMagic = 0x49505743; // "IPWC"
+  static constexpr std::size_t kMaxWorkers = 256;     ///< Most worker processes.
+
+  std::uint32_t magic;             ///< kMagic once the segment is initialized.
+  std::uint32_t worker_count;      ///< Number of slots in use.
+  std::atomic<bool> shutdown;      ///< Set by the supervisor to make workers exit.
+  WorkerSlot slots[kMaxWorkers];   ///< One slot per worker process.
+};
+
+/**
+ * @brief Returns the CLOCK_MONOTONIC time in nanoseconds, comparable across processes.
+ */
+inline std::uint64_t MonotonicNanoseconds() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+/**
+ * @class IdleBackoff
+ * @brief Polling strategy for the ends of a WorkerChannel: yields for a while after the
+ * last piece of work, then sleeps briefly so idle processes do not spin a CPU.
+ */
+class IdleBackoff {
+public:
+  /**
+   * @brief Called after doing work; the next Wait() yields again.
+   */
+  void Reset() { idle_rounds_ = 0; }
+
+  /**
+   * @brief Called when there was nothing to do.
+   */
+  void Wait() {
+    if (++idle_rounds_ < kYieldRounds) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+private:
+  static constexpr unsigned kYieldRounds = 256;
+
+  unsigned idle_rounds_ = 0;
+};
+
+/**
+ * @class SharedChannel
+ * @brief Owns a mapping of a WorkerChannel in POSIX shared memory.
+ *
+ * The supervisor creates the segment and unlinks it when it is destroyed; worker
+ * processes attach to it by name.
+ */
+class SharedChannel {
+public:
+  /**
+   * @brief Creates and initializes a new segment.
+   *
+   * @param name Name of the segment, as passed to shm_open().
+   * @param worker_count Number of worker slots to initialize.
+   * @throw std::system_error if the segment cannot be created or mapped.
+   */
+  static SharedChannel Create(const std::string& name, std::size_t worker_count);
+
+  /**
+   * @brief Maps an existing segment created by Create().
+   *
+   * @param name Name of the segment, as passed to shm_open().
+   * @throw std::system_error if the segment cannot be opened or mapped.
+   * @throw std::runtime_error if the segment is not an initialized WorkerChannel.
+   */
+  static SharedChannel Attach(const std::string& name);
+
+  SharedChannel(SharedChannel&& other) noexcept;
+  SharedChannel& operator=(SharedChannel&&) = delete;
+  SharedChannel(const SharedChannel&) = delete;
+  SharedChannel& operator=(const SharedChannel&) = delete;
+
+  /**
+   * @brief Unmaps the segment, and unlinks it if this mapping created it.
+   */
+  ~SharedChannel();
+
+  WorkerChannel* operator->() const { return channel_; }
+
+  const std::string& Name() const { return name_; }
+
+private:
+  SharedChannel(std::string name, WorkerChannel* channel, bool owner);
+
+  /**
+   * @brief Name of the segment.
+   */
+  std::string name_;
+
+  /**
+   * @brief The mapped channel, null once moved from.
+   */
+  WorkerChannel* channel_;
+
+  /**
+   * @brief True if this mapping created, and must unlink, the segment.
+   */
+  bool owner_;
+};
+
+} // namespace image_processor
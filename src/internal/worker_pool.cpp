@@ -1,45 +1,205 @@
 #include "worker_pool.hpp"
 #include "image_processor.hpp"
 
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <pwd.h>
 #include <stdexcept>
+#include <tbb/task_arena.h>
 #include <thread>
+#include <unistd.h>
 
 namespace image_processor {
 
+namespace {
+
+std::string ResolveOutputDirectory(const std::string& output_directory) {
+  if (!output_directory.empty()) {
+    return output_directory;
+  }
+
+  const char* home = std::getenv("HOME");
+  if (home == nullptr || *home == '\0') {
+    const passwd* entry = getpwuid(getuid());
+    home = entry != nullptr ? entry->pw_dir : ".";
+  }
+  return (std::filesystem::path(home) / "processed_images").string();
+}
+
+} // namespace
+
 WorkerPool::WorkerPool(
-    tbb::concurrent_queue<Task>& task_queue,
-    tbb::concurrent_hash_map<std::string, std::string>& result_storage,
-    tbb::concurrent_hash_map<std::string, ImageProcessingError> error_storage)
-    : is_running_(false), task_queue_(task_queue), result_storage_(result_storage),
-      error_storage_(error_storage) {}
+    TaskQueue& task_queue,
+    tbb::concurrent_hash_map<std::string, TaskResult>& result_storage,
+    tbb::concurrent_hash_map<std::string, ImageProcessingError>& error_storage,
+    CancellationRegistry& cancellation)
+    : is_running_(false), numa_mode_(Options::NumaMode::kDisabled),
+      streaming_threshold_(0), task_queue_(task_queue), result_storage_(result_storage),
+      error_storage_(error_storage), cancellation_(cancellation) {}
+
+void WorkerPool::HandleTaskQueue(std::size_t index, WorkerPlacement placement) {
+  ApplyWorkerPlacement(placement, numa_mode_);
+
+  // One arena per width this worker has run with; TBB code in the filters only uses the
+  // threads of the arena it is called from.
+  std::map<int, std::unique_ptr<tbb::task_arena>> arenas;
 
-void WorkerPool::HandleTaskQueue() {
   while (is_running_.load()) {
+    concurrency_.MaybeUpdate(task_queue_.MemorySize());
+    if (!concurrency_.IsActive(index)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
     Task task;
-    if (!task_queue_.try_pop(task)) {
+    if (!task_queue_.TryPop(task, placement.node)) {
       std::this_thread::yield();
       continue;
     }
 
-    ImageProcessor processor(task.image, task.operations, "~/processed_images");
-    const auto error_code = processor.ProcessImage();
+    if (cancellation_.IsCancelled(task)) {
+      cancellation_.RecordSkipped(task.operations->Filters().size());
+      error_storage_.insert({task.id, ImageProcessingError::kCancelled});
+      cancellation_.Finish(task.id, task.sequence);
+      continue;
+    }
+
+    concurrency_.TaskStarted();
+    ImageProcessor processor(task.image, *task.operations, processed_images_path_,
+                             streaming_threshold_,
+                             [&] { return cancellation_.IsCancelled(task); });
+    if (shard_sink_) {
+      processor.EncodeToMemory();
+    }
+    ImageProcessingError error_code;
+    const auto process = [&] {
+      try {
+        error_code = processor.ProcessImage();
+      } catch (const std::exception&) {
+        // A kernel that throws must not take the worker thread down with it.
+        error_code = ImageProcessingError::kProcessingFailed;
+      }
+    };
+    if (const int width = concurrency_.InnerThreads(); width > 0) {
+      auto& arena = arenas[width];
+      if (!arena) {
+        arena = std::make_unique<tbb::task_arena>(width);
+      }
+      arena->execute(process);
+    } else {
+      process();
+    }
+    concurrency_.TaskFinished(processor.GetInputPixelCount());
+
+    if (error_code == ImageProcessingError::kCancelled) {
+      cancellation_.RecordStopped(processor.GetSkippedFilterCount());
+    }
+
     if (error_code != ImageProcessingError::kNoError) {
       error_storage_.insert({task.id, error_code});
+    } else if (auto encoded = processor.TakeEncodedImage(); !encoded.empty()) {
+      // The outcome is stored once the sink has written the batch.
+      const auto extension = std::filesystem::path(task.image).extension().string();
+      shard_sink_->Append(task.id + extension, std::move(encoded),
+                          [this, task_id = task.id, sequence = task.sequence](
+                              ImageProcessingError error, const ResultLocator& locator) {
+                            StoreShardResult(task_id, sequence, error, locator);
+                          });
       continue;
+    } else {
+      result_storage_.insert({task.id, TaskResult{{processor.GetResultImagePath()}}});
     }
+    cancellation_.Finish(task.id, task.sequence);
+  }
+}
 
-    result_storage_.insert({task.id, processor.GetResultImagePath()});
+void WorkerPool::StoreShardResult(const std::string& task_id, std::uint64_t sequence,
+                                  ImageProcessingError error,
+                                  const ResultLocator& locator) {
+  if (error != ImageProcessingError::kNoError) {
+    error_storage_.insert({task_id, error});
+  } else {
+    result_storage_.insert({task_id, TaskResult{locator, true}});
   }
+  cancellation_.Finish(task_id, sequence);
 }
 
-void WorkerPool::Start() {
+void WorkerPool::Start(const Options& options) {
+  if (options.execution_mode == Options::ExecutionMode::kOutOfProcess &&
+      options.output_sink == Options::OutputSink::kShards) {
+    throw std::invalid_argument("Shard output is only supported in-process.");
+  }
+
   bool expected = false;
   if (!is_running_.compare_exchange_strong(expected, true)) {
     throw std::runtime_error("Worker threads are already running.");
   }
 
-  for (size_t i = 0; i < std::thread::hardware_concurrency(); ++i) {
-    workers_.emplace_back(&WorkerPool::HandleTaskQueue, this);
+  try {
+    processed_images_path_ = ResolveOutputDirectory(options.output_directory);
+    std::filesystem::create_directories(processed_images_path_);
+    task_queue_.ConfigureSpill(options.spill_threshold,
+                               options.spill_directory.empty()
+                                   ? std::filesystem::temp_directory_path() /
+                                         "image_processor_spill"
+                                   : std::filesystem::path(options.spill_directory));
+  } catch (...) {
+    is_running_.store(false);
+    throw;
+  }
+
+  const CpuTopology topology = CpuTopology::Detect();
+  const std::size_t worker_count =
+      options.worker_count != 0 ? options.worker_count : topology.CpuCount();
+
+  if (options.execution_mode == Options::ExecutionMode::kOutOfProcess) {
+    task_queue_.Reshard(1);
+    Options process_options = options;
+    process_options.worker_count = worker_count;
+    try {
+      process_pool_ = std::make_unique<WorkerProcessPool>(task_queue_, result_storage_,
+                                                          error_storage_, cancellation_);
+      process_pool_->Start(process_options, processed_images_path_);
+    } catch (...) {
+      process_pool_.reset();
+      is_running_.store(false);
+      throw;
+    }
+    return;
+  }
+
+  numa_mode_ = options.numa_mode;
+  streaming_threshold_ = options.streaming_threshold;
+  try {
+    if (options.output_sink == Options::OutputSink::kShards) {
+      shard_sink_ =
+          std::make_unique<ShardSink>(processed_images_path_, options.shard_size);
+    }
+    task_queue_.Reshard(numa_mode_ == Options::NumaMode::kNodeLocal
+                            ? topology.node_cpus.size()
+                            : 1);
+
+    concurrency_.Start(worker_count, topology.CpuCount(),
+                       options.concurrency == Options::Concurrency::kAdaptive);
+
+    std::size_t index = 0;
+    for (auto& placement : PlanWorkerPlacement(topology, worker_count,
+                                               options.cpu_affinity, options.numa_mode)) {
+      workers_.emplace_back(&WorkerPool::HandleTaskQueue, this, index++,
+                            std::move(placement));
+    }
+  } catch (...) {
+    // Workers that did start see the flag and exit; whatever they finished is stored.
+    is_running_.store(false);
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+    workers_.clear();
+    concurrency_.Stop();
+    shard_sink_.reset();
+    throw;
   }
 }
 
@@ -49,6 +209,11 @@ void WorkerPool::Stop() {
     throw std::runtime_error("Worker threads are already stopped.");
   }
 
+  if (process_pool_) {
+    process_pool_->Stop();
+    process_pool_.reset();
+  }
+
   for (auto& worker : workers_) {
     if (worker.joinable()) {
       worker.join();
@@ -56,6 +221,8 @@ void WorkerPool::Stop() {
   }
 
   workers_.clear();
+  concurrency_.Stop();
+  shard_sink_.reset();
 }
 
 WorkerPool::~WorkerPool() {
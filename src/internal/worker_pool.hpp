@@ -1,10 +1,18 @@
 #pragma once
 
-#include "task.hpp"
+#include "cancellation_registry.hpp"
+#include "concurrency_controller.hpp"
+#include "cpu_topology.hpp"
+#include "shard_sink.hpp"
+#include "task_queue.hpp"
+#include "worker_process_pool.hpp"
 #include <atomic>
 #include <image_processor/error.hpp>
+#include <image_processor/options.hpp>
+#include <image_processor/result_locator.hpp>
+#include <memory>
+#include <string>
 #include <tbb/concurrent_hash_map.h>
-#include <tbb/concurrent_queue.h>
 #include <thread>
 #include <vector>
 
@@ -16,7 +24,8 @@ namespace image_processor {
  *
  * This class represents a pool of worker threads designed to pick and execute image
  * processing tasks from a concurrent queue. The results and errors from the image
- * processing are stored in concurrent hash maps for further retrieval.
+ * processing are stored in concurrent hash maps for further retrieval. In out-of-process
+ * mode the tasks are handed to a WorkerProcessPool instead of worker threads.
  */
 // clang-format off
 class WorkerPool {
@@ -27,10 +36,12 @@ public:
      * @param task_queue A concurrent queue from which worker threads will pick tasks for execution.
      * @param result_storage A concurrent hash map to store the results of successfully processed images.
      * @param error_storage A concurrent hash map to store errors encountered during image processing.
+     * @param cancellation Registry of submitted tasks, polled to skip or stop cancelled ones.
      */
-    WorkerPool(tbb::concurrent_queue<Task>& task_queue,
-               tbb::concurrent_hash_map<std::string, std::string>& result_storage,
-               tbb::concurrent_hash_map<std::string, ImageProcessingError> error_storage);
+    WorkerPool(TaskQueue& task_queue,
+               tbb::concurrent_hash_map<std::string, TaskResult>& result_storage,
+               tbb::concurrent_hash_map<std::string, ImageProcessingError>& error_storage,
+               CancellationRegistry& cancellation);
 
     /**
      * @brief Destructor for the WorkerPool class.
@@ -46,16 +57,24 @@ public:
      * @brief Starts all worker threads to begin processing tasks from the queue.
      * 
      * This function initializes and starts the worker threads to pick and process tasks. 
-     * Each thread will run the HandleTaskQueue method.
+     * Each thread will run the HandleTaskQueue method. The output directory is created if it
+     * does not exist, the task queue is resharded per NUMA node in node-local mode and
+     * spilling to disk is configured. In out-of-process mode worker processes are spawned
+     * instead of threads.
      * 
+     * @param options Worker count, output directory, pinning, NUMA and execution mode configuration.
      * @throw std::runtime_error if the worker threads are already running when attempting to start them.
+     * @throw std::invalid_argument if shard output is requested with out-of-process execution.
+     * @throw std::system_error if the output or spill directory cannot be created, or a worker thread or process cannot be started.
+     * Whatever Start() throws, the pool is left stopped and can be started again.
      */
-    void Start();
+    void Start(const Options& options);
 
     /**
      * @brief Stops all worker threads gracefully.
      * 
      * This function signals the worker threads to stop processing and waits for their completion.
+     * Results still waiting for their shard are written before it returns.
      * 
      * @throw std::runtime_error if the worker threads are already stopped when attempting to stop them.
      */
@@ -64,12 +83,23 @@ public:
 
 private:
     /**
-     * @brief Function executed by each worker thread to process tasks from t   he queue.
+     * @brief Function executed by each worker thread to process tasks from the queue.
      * 
      * The worker thread will continually try to dequeue tasks from the task queue and process them 
-     * until the pool is signaled to stop.
+     * until the pool is signaled to stop. Workers the concurrency controller has parked
+     * take no tasks, and filters run with as many threads as the controller allows.
+     * Cancelled tasks are dropped when dequeued and stopped between filter steps.
+     *
+     * @param index Index of this worker, workers with a lower index are parked last.
+     * @param placement CPUs and preferred queue shard of this worker.
+     */
+    void HandleTaskQueue(std::size_t index, WorkerPlacement placement);
+
+    /**
+     * @brief Stores the outcome of a result the shard sink has written, or failed to.
      */
-    void HandleTaskQueue();
+    void StoreShardResult(const std::string& task_id, std::uint64_t sequence,
+                          ImageProcessingError error, const ResultLocator& locator);
 
     /**
      * @brief Atomic flag indicating the running status of worker threads.
@@ -81,20 +111,55 @@ private:
      */
     std::vector<std::thread> workers_;
 
+    /**
+     * @brief Worker processes, set while running in out-of-process mode.
+     */
+    std::unique_ptr<WorkerProcessPool> process_pool_;
+
+    /**
+     * @brief Splits the CPUs between worker threads and the threads of their filters.
+     */
+    ConcurrencyController concurrency_;
+
+    /**
+     * @brief NUMA policy the workers were started with.
+     */
+    Options::NumaMode numa_mode_;
+
+    /**
+     * @brief Pixel count from which images are streamed in strips, 0 to never stream.
+     */
+    std::uint64_t streaming_threshold_;
+
+    /**
+     * @brief Directory where processed images are saved.
+     */
+    std::string processed_images_path_;
+
+    /**
+     * @brief Packs results into shards, set while running with OutputSink::kShards.
+     */
+    std::unique_ptr<ShardSink> shard_sink_;
+
     /**
      * @brief Reference to the task queue from which tasks are consumed.
      */
-    tbb::concurrent_queue<Task>& task_queue_;
+    TaskQueue& task_queue_;
 
     /**
      * @brief Reference to the map where processed results are stored.
      */
-    tbb::concurrent_hash_map<std::string, std::string>& result_storage_;
+    tbb::concurrent_hash_map<std::string, TaskResult>& result_storage_;
 
     /**
      * @brief Reference to the map where any processing errors are stored.
      */
     tbb::concurrent_hash_map<std::string, ImageProcessingError>& error_storage_;
+
+    /**
+     * @brief Reference to the registry of submitted and cancelled tasks.
+     */
+    CancellationRegistry& cancellation_;
 };
 // clang-format on
 
@@ -0,0 +1,396 @@
+#include "worker_process_pool.hpp"
+#include "cpu_topology.hpp"
+#include "task_codec.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace image_processor {
+
+namespace {
+
+/**
+ * @brief Requests kept queued per worker, so a worker picks up its next task as soon as
+ * it finishes one instead of waiting for the supervisor.
+ */
+constexpr std::size_t kDispatchDepth = 2;
+static_assert(kDispatchDepth <= WorkerSlot::kRingCapacity,
+              "Dispatch depth must fit in a worker's request ring");
+
+constexpr std::uint64_t kCheckIntervalNs = 10'000'000;   // 10 ms
+constexpr std::uint64_t kRespawnDelayNs = 1'000'000'000; // 1 s
+
+/**
+ * @brief Time Stop() gives workers to finish their current task before killing them.
+ */
+constexpr std::uint64_t kStopGraceNs = 30'000'000'000; // 30 s
+
+std::string ChannelName() {
+  static std::atomic<unsigned> counter{0};
+  return "/image_processor_" + std::to_string(getpid()) + "_" +
+         std::to_string(counter.fetch_add(1));
+}
+
+} // namespace
+
+WorkerProcessPool::WorkerProcessPool(
+    TaskQueue& task_queue,
+    tbb::concurrent_hash_map<std::string, TaskResult>& result_storage,
+    tbb::concurrent_hash_map<std::string, ImageProcessingError>& error_storage,
+    CancellationRegistry& cancellation)
+    : is_running_(false), next_ticket_(1), max_attempts_(1), task_timeout_ns_(0),
+      inner_threads_(0), streaming_threshold_(0), last_check_ns_(0),
+      cancel_generation_(0), task_queue_(task_queue), result_storage_(result_storage),
+      error_storage_(error_storage), cancellation_(cancellation) {}
+
+WorkerProcessPool::~WorkerProcessPool() {
+  if (is_running_.load()) {
+    Stop();
+  }
+}
+
+void WorkerProcessPool::Start(const Options& options,
+                              const std::string& output_directory) {
+  bool expected = false;
+  if (!is_running_.compare_exchange_strong(expected, true)) {
+    throw std::runtime_error("Worker processes are already running.");
+  }
+
+  executable_ = !options.worker_executable.empty()
+                    ? options.worker_executable
+                    : (std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                       "image_processor_worker")
+                          .string();
+  output_directory_ = output_directory;
+  max_attempts_ = std::max<std::size_t>(options.max_task_attempts, 1);
+  task_timeout_ns_ = static_cast<std::uint64_t>(options.task_timeout_ms) * 1'000'000;
+  streaming_threshold_ = options.streaming_threshold;
+
+  const std::size_t worker_count =
+      std::clamp<std::size_t>(options.worker_count != 0
+                                  ? options.worker_count
+                                  : std::thread::hardware_concurrency(),
+                              1, WorkerChannel::kMaxWorkers);
+
+  // Workers do not share a pool of filter threads, so each gets its share of the CPUs.
+  inner_threads_ = options.concurrency == Options::Concurrency::kAdaptive
+                       ? std::max<std::size_t>(1, CpuTopology::Detect().CpuCount() /
+                                                      worker_count)
+                       : 0;
+
+  try {
+    channel_ =
+        std::make_unique<SharedChannel>(SharedChannel::Create(ChannelName(), worker_count));
+    workers_.assign(worker_count, WorkerProcess{});
+    for (std::size_t worker = 0; worker < worker_count; ++worker) {
+      if (const int error = Spawn(worker); error != 0) {
+        throw std::system_error(error, std::generic_category(), "spawn " + executable_);
+      }
+    }
+  } catch (...) {
+    for (const auto& worker : workers_) {
+      if (worker.pid != 0) {
+        kill(worker.pid, SIGKILL);
+        waitpid(worker.pid, nullptr, 0);
+      }
+    }
+    workers_.clear();
+    channel_.reset();
+    is_running_.store(false);
+    throw;
+  }
+
+  next_ticket_ = 1;
+  last_check_ns_ = MonotonicNanoseconds();
+  cancel_generation_ = cancellation_.Generation();
+  supervisor_ = std::thread(&WorkerProcessPool::Supervise, this);
+}
+
+void WorkerProcessPool::Stop() {
+  bool expected = true;
+  if (!is_running_.compare_exchange_strong(expected, false)) {
+    return;
+  }
+
+  if (supervisor_.joinable()) {
+    supervisor_.join();
+  }
+
+  workers_.clear();
+  channel_.reset();
+}
+
+void WorkerProcessPool::Supervise() {
+  IdleBackoff backoff;
+  while (is_running_.load()) {
+    bool busy = false;
+    for (std::size_t worker = 0; worker < workers_.size(); ++worker) {
+      busy |= workers_[worker].pid != 0 && Collect(worker);
+    }
+    busy |= Dispatch();
+    SignalCancellations();
+
+    const std::uint64_t now = MonotonicNanoseconds();
+    if (now - last_check_ns_ >= kCheckIntervalNs) {
+      CheckWorkers(true);
+      last_check_ns_ = now;
+    }
+
+    if (busy) {
+      backoff.Reset();
+    } else {
+      backoff.Wait();
+    }
+  }
+
+  // Workers exit once they finish their current task; keep collecting until they have.
+  // Those still running after the grace period are killed, and their tasks retried or
+  // failed like after a crash.
+  (*channel_)->shutdown.store(true);
+  const std::uint64_t kill_ns = MonotonicNanoseconds() + kStopGraceNs;
+  bool killed = false;
+  while (std::any_of(workers_.begin(), workers_.end(),
+                     [](const WorkerProcess& worker) { return worker.pid != 0; })) {
+    for (std::size_t worker = 0; worker < workers_.size(); ++worker) {
+      if (workers_[worker].pid != 0) {
+        Collect(worker);
+      }
+    }
+    CheckWorkers(false);
+    if (!killed && MonotonicNanoseconds() >= kill_ns) {
+      for (const auto& worker : workers_) {
+        if (worker.pid != 0) {
+          kill(worker.pid, SIGKILL);
+        }
+      }
+      killed = true;
+    }
+    backoff.Wait();
+  }
+
+  // Every dispatched task has either been answered or moved to retries_ by HandleExit.
+  for (auto& retry : retries_) {
+    task_queue_.Push(std::move(retry.first));
+  }
+  retries_.clear();
+  in_flight_.clear();
+}
+
+bool WorkerProcessPool::Dispatch() {
+  bool dispatched = false;
+  WorkerRequest request;
+
+  // Give every idle worker a task before queueing a second one behind a busy worker.
+  for (std::size_t depth = 0; depth < kDispatchDepth; ++depth) {
+    for (std::size_t index = 0; index < workers_.size(); ++index) {
+      WorkerProcess& worker = workers_[index];
+      if (worker.pid == 0 || worker.in_flight > depth) {
+        continue;
+      }
+
+      auto next = NextTask();
+      if (!next) {
+        return dispatched;
+      }
+      dispatched = true;
+
+      auto& [task, attempts] = *next;
+      encode_buffer_.clear();
+      task_codec::EncodeTask(task, encode_buffer_);
+      if (encode_buffer_.size() > WorkerRequest::kMaxPayload) {
+        // Only an image path far beyond PATH_MAX gets here.
+        error_storage_.insert({task.id, ImageProcessingError::kImageInaccessible});
+        cancellation_.Finish(task.id, task.sequence);
+        continue;
+      }
+
+      request.ticket = next_ticket_++;
+      request.size = static_cast<std::uint32_t>(encode_buffer_.size());
+      std::memcpy(request.payload, encode_buffer_.data(), encode_buffer_.size());
+
+      // Cannot fail: in_flight counts every request in the ring and stays below capacity.
+      (*channel_)->slots[index].requests.TryPush(request);
+      in_flight_.emplace(request.ticket,
+                         InFlightTask{std::move(task), index, attempts, false});
+      ++worker.in_flight;
+    }
+  }
+
+  return dispatched;
+}
+
+bool WorkerProcessPool::Collect(std::size_t worker) {
+  bool collected = false;
+  WorkerResponse response;
+  while ((*channel_)->slots[worker].responses.TryPop(response)) {
+    collected = true;
+    auto it = in_flight_.find(response.ticket);
+    if (it == in_flight_.end()) {
+      continue;
+    }
+
+    if (response.error == ImageProcessingError::kCancelled) {
+      if (response.decoded) {
+        cancellation_.RecordStopped(response.skipped_filters);
+      } else {
+        cancellation_.RecordSkipped(response.skipped_filters);
+      }
+    }
+
+    if (response.error == ImageProcessingError::kNoError) {
+      TaskResult result{{std::string(response.result, response.size)}};
+      result_storage_.insert({it->second.task.id, std::move(result)});
+    } else {
+      error_storage_.insert({it->second.task.id, response.error});
+    }
+
+    cancellation_.Finish(it->second.task.id, it->second.task.sequence);
+    in_flight_.erase(it);
+    --workers_[worker].in_flight;
+  }
+
+  return collected;
+}
+
+void WorkerProcessPool::CheckWorkers(bool respawn) {
+  const std::uint64_t now = MonotonicNanoseconds();
+  for (std::size_t index = 0; index < workers_.size(); ++index) {
+    WorkerProcess& worker = workers_[index];
+    if (worker.pid == 0) {
+      if (respawn && now >= worker.respawn_ns && Spawn(index) != 0) {
+        worker.respawn_ns = now + kRespawnDelayNs;
+      }
+      continue;
+    }
+
+    if (waitpid(worker.pid, nullptr, WNOHANG) == worker.pid) {
+      HandleExit(index);
+      if (respawn && Spawn(index) != 0) {
+        worker.respawn_ns = now + kRespawnDelayNs;
+      }
+      continue;
+    }
+
+    // The worker stores started_ns before current_ticket, so a ticket read here is never
+    // paired with the start time of an earlier task.
+    const WorkerSlot& slot = (*channel_)->slots[index];
+    if (task_timeout_ns_ != 0 && slot.current_ticket.load() != 0 &&
+        now - std::min(now, slot.started_ns.load()) > task_timeout_ns_) {
+      kill(worker.pid, SIGKILL); // Reaped, and its task retried, on a later check.
+    }
+  }
+}
+
+void WorkerProcessPool::HandleExit(std::size_t worker) {
+  // Responses published before the worker died are still valid.
+  Collect(worker);
+
+  WorkerSlot& slot = (*channel_)->slots[worker];
+  const std::uint64_t crashed_ticket = slot.current_ticket.load();
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (it->second.worker != worker) {
+      ++it;
+      continue;
+    }
+
+    const std::size_t attempts =
+        it->second.attempts + (it->first == crashed_ticket ? 1 : 0);
+    if (attempts >= max_attempts_) {
+      error_storage_.insert({it->second.task.id, ImageProcessingError::kWorkerCrashed});
+      cancellation_.Finish(it->second.task.id, it->second.task.sequence);
+    } else {
+      retries_.emplace_back(std::move(it->second.task), attempts);
+    }
+    it = in_flight_.erase(it);
+  }
+
+  slot.requests.Reset();
+  slot.responses.Reset();
+  slot.current_ticket.store(0);
+  slot.started_ns.store(0);
+  for (auto& cancelled : slot.cancelled_tickets) {
+    cancelled.store(0);
+  }
+  workers_[worker].pid = 0;
+  workers_[worker].in_flight = 0;
+}
+
+int WorkerProcessPool::Spawn(std::size_t worker) {
+  std::vector<std::string> arguments = {
+      executable_,
+      "--channel=" + channel_->Name(),
+      "--slot=" + std::to_string(worker),
+      "--output=" + output_directory_,
+      "--parent=" + std::to_string(getpid()),
+      "--streaming-threshold=" + std::to_string(streaming_threshold_),
+  };
+  if (inner_threads_ != 0) {
+    arguments.push_back("--threads=" + std::to_string(inner_threads_));
+  }
+  std::vector<char*> argv;
+  for (auto& argument : arguments) {
+    argv.push_back(argument.data());
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid = 0;
+  const int error =
+      posix_spawn(&pid, executable_.c_str(), nullptr, nullptr, argv.data(), environ);
+  if (error == 0) {
+    workers_[worker].pid = pid;
+  }
+  return error;
+}
+
+std::optional<std::pair<Task, std::size_t>> WorkerProcessPool::NextTask() {
+  while (true) {
+    std::optional<std::pair<Task, std::size_t>> next;
+    if (!retries_.empty()) {
+      next = std::move(retries_.front());
+      retries_.pop_front();
+    } else if (Task task; task_queue_.TryPop(task, 0)) {
+      next = std::make_pair(std::move(task), std::size_t{0});
+    } else {
+      return std::nullopt;
+    }
+
+    const Task& task = next->first;
+    if (!cancellation_.IsCancelled(task)) {
+      return next;
+    }
+    cancellation_.RecordSkipped(task.operations->Filters().size());
+    error_storage_.insert({task.id, ImageProcessingError::kCancelled});
+    cancellation_.Finish(task.id, task.sequence);
+  }
+}
+
+void WorkerProcessPool::SignalCancellations() {
+  const std::uint64_t generation = cancellation_.Generation();
+  if (generation == cancel_generation_) {
+    return;
+  }
+  cancel_generation_ = generation;
+
+  for (auto& [ticket, in_flight] : in_flight_) {
+    if (in_flight.cancel_sent || !cancellation_.IsCancelled(in_flight.task)) {
+      continue;
+    }
+
+    WorkerProcess& worker = workers_[in_flight.worker];
+    (*channel_)->slots[in_flight.worker]
+        .cancelled_tickets[worker.next_cancel++ % WorkerSlot::kRingCapacity]
+        .store(ticket);
+    in_flight.cancel_sent = true;
+  }
+}
+
+} // namespace image_processor
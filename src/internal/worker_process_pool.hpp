@@ -0,0 +1,251 @@
+#pragma once
+
+#include "cancellation_registry.hpp"
+#include "task_queue.hpp"
+#include "worker_channel.hpp"
+#include <image_processor/error.hpp>
+#include <image_processor/options.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <tbb/concurrent_hash_map.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace image_processor {
+
+/**
+ * @class WorkerProcessPool
+ * @brief Runs queued tasks in image_processor_worker processes.
+ *
+ * A supervisor thread moves tasks from the TaskQueue into per-worker lock-free rings in a
+ * shared-memory WorkerChannel and collects the outcomes from the matching response rings.
+ * Only the encoded task (image path and filter chain) and the result path cross the
+ * process boundary: workers decode and encode images themselves, so no pixel data is ever
+ * copied between processes.
+ *
+ * The supervisor reaps workers that exit and kills those that exceed the task timeout,
+ * then restarts them. Tasks that were queued to a dead worker but not started are
+ * dispatched again as is; the task it was running counts as a failed attempt and fails
+ * with kWorkerCrashed once it has used up its attempts.
+ *
+ * Cancelled tasks are dropped before dispatch. For dispatched ones the supervisor posts
+ * the ticket to the worker's slot, which the worker polls between filter steps.
+ */
+class WorkerProcessPool {
+public:
+  /**
+   * @brief Constructs the pool with references to a task queue, result storage, and error
+   * storage, and the registry of cancelled tasks.
+   */
+  WorkerProcessPool(
+      TaskQueue& task_queue,
+      tbb::concurrent_hash_map<std::string, TaskResult>& result_storage,
+      tbb::concurrent_hash_map<std::string, ImageProcessingError>& error_storage,
+      CancellationRegistry& cancellation);
+
+  /**
+   * @brief Stops the pool if it is still running.
+   */
+  ~WorkerProcessPool();
+
+  /**
+   * @brief Creates the shared channel, spawns the worker processes and starts supervising
+   * them.
+   *
+   * @param options Worker count, worker executable, attempts and timeout.
+   * @param output_directory Existing directory where workers save processed images.
+   * @throw std::system_error if the channel cannot be created or a worker cannot be
+   * spawned.
+   */
+  void Start(const Options& options, const std::string& output_directory);
+
+  /**
+   * @brief Lets the workers finish the tasks they are running, waits for them to exit and
+   * returns every task they did not start to the task queue.
+   *
+   * Workers still running 30 s after Stop() are killed; their tasks count as crashed.
+   */
+  void Stop();
+
+private:
+  /**
+   * @struct WorkerProcess
+   * @brief Supervisor-side state of one worker process.
+   */
+  struct WorkerProcess {
+    pid_t pid = 0;                 ///< Process id, 0 while not running.
+    std::size_t in_flight = 0;     ///< Requests dispatched and not yet answered.
+    std::uint64_t respawn_ns = 0;  ///< Earliest time to retry a failed spawn.
+    std::size_t next_cancel = 0;   ///< Next entry of the slot's cancelled_tickets.
+  };
+
+  /**
+   * @struct InFlightTask
+   * @brief A dispatched task awaiting its response.
+   */
+  struct InFlightTask {
+    Task task;              ///< The task itself, kept to retry it.
+    std::size_t worker;     ///< Index of the worker it was dispatched to.
+    std::size_t attempts;   ///< Attempts that took down a worker so far.
+    bool cancel_sent;       ///< True once the worker was told the task is cancelled.
+  };
+
+  /**
+   * @brief Body of the supervisor thread.
+   */
+  void Supervise();
+
+  /**
+   * @brief Fills the request rings of live workers up to the dispatch depth.
+   *
+   * @return true if at least one task was dispatched.
+   */
+  bool Dispatch();
+
+  /**
+   * @brief Drains the response ring of a worker into the result and error storage.
+   *
+   * @return true if at least one response was collected.
+   */
+  bool Collect(std::size_t worker);
+
+  /**
+   * @brief Reaps exited workers, kills hung ones and restarts them.
+   *
+   * @param respawn false while stopping, when exited workers stay down.
+   */
+  void CheckWorkers(bool respawn);
+
+  /**
+   * @brief Retries or fails the tasks of a worker that exited and resets its slot.
+   */
+  void HandleExit(std::size_t worker);
+
+  /**
+   * @brief Starts the worker process for a slot.
+   *
+   * @return 0 on success, otherwise the error returned by posix_spawn().
+   */
+  int Spawn(std::size_t worker);
+
+  /**
+   * @brief Returns the next task to dispatch: a retried one first, then a queued one.
+   * Cancelled tasks are failed with kCancelled on the way.
+   */
+  std::optional<std::pair<Task, std::size_t>> NextTask();
+
+  /**
+   * @brief Tells workers about their dispatched tasks cancelled since the last call.
+   */
+  void SignalCancellations();
+
+  /**
+   * @brief Atomic flag indicating the running status of the supervisor.
+   */
+  std::atomic<bool> is_running_;
+
+  /**
+   * @brief The supervisor thread.
+   */
+  std::thread supervisor_;
+
+  /**
+   * @brief Shared-memory channel to the workers.
+   */
+  std::unique_ptr<SharedChannel> channel_;
+
+  /**
+   * @brief Supervisor-side state of each worker, indexed like the channel's slots.
+   */
+  std::vector<WorkerProcess> workers_;
+
+  /**
+   * @brief Dispatched tasks by ticket. Only touched by the supervisor thread.
+   */
+  std::unordered_map<std::uint64_t, InFlightTask> in_flight_;
+
+  /**
+   * @brief Tasks to dispatch again, with their attempt counts.
+   */
+  std::deque<std::pair<Task, std::size_t>> retries_;
+
+  /**
+   * @brief Ticket of the next dispatch; 0 is reserved for "idle".
+   */
+  std::uint64_t next_ticket_;
+
+  /**
+   * @brief Reused buffer for encoding requests.
+   */
+  std::string encode_buffer_;
+
+  /**
+   * @brief Path of the worker executable.
+   */
+  std::string executable_;
+
+  /**
+   * @brief Directory where workers save processed images.
+   */
+  std::string output_directory_;
+
+  /**
+   * @brief Attempts allowed per task.
+   */
+  std::size_t max_attempts_;
+
+  /**
+   * @brief Time a worker may spend on one task, 0 for no limit.
+   */
+  std::uint64_t task_timeout_ns_;
+
+  /**
+   * @brief Threads each worker's filters may use, 0 to leave them unlimited.
+   */
+  std::size_t inner_threads_;
+
+  /**
+   * @brief Pixel count from which workers stream images in strips, 0 to never stream.
+   */
+  std::uint64_t streaming_threshold_;
+
+  /**
+   * @brief Time workers were last checked for exits and timeouts.
+   */
+  std::uint64_t last_check_ns_;
+
+  /**
+   * @brief CancellationRegistry::Generation() at the last SignalCancellations().
+   */
+  std::uint64_t cancel_generation_;
+
+  /**
+   * @brief Reference to the task queue from which tasks are consumed.
+   */
+  TaskQueue& task_queue_;
+
+  /**
+   * @brief Reference to the map where processed results are stored.
+   */
+  tbb::concurrent_hash_map<std::string, TaskResult>& result_storage_;
+
+  /**
+   * @brief Reference to the map where any processing errors are stored.
+   */
+  tbb::concurrent_hash_map<std::string, ImageProcessingError>& error_storage_;
+
+  /**
+   * @brief Reference to the registry of submitted and cancelled tasks.
+   */
+  CancellationRegistry& cancellation_;
+};
+
+} // namespace image_processor
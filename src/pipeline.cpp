@@ -0,0 +1,11 @@
+#include <image_processor/pipeline.hpp>
+
+#include "internal/filter_chain.hpp"
+
+namespace image_processor {
+
+Pipeline::Pipeline(std::shared_ptr<const FilterChain> chain) : chain_(std::move(chain)) {}
+
+bool Pipeline::IsValid() const { return chain_ && chain_->IsValid(); }
+
+} // namespace image_processor
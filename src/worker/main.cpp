@@ -0,0 +1,184 @@
+/**
+ * @file main.cpp
+ * @brief image_processor_worker: runs tasks sent by a WorkerProcessPool over a shared
+ * WorkerChannel.
+ *
+ * Spawned by the library in out-of-process mode, not meant to be started by hand:
+ *
+ *   image_processor_worker --channel=NAME --slot=N --output=DIR --parent=PID
+ *                          [--threads=N] [--streaming-threshold=PIXELS]
+ *
+ * --threads limits the threads the filters of this worker may use; images of at least
+ * --streaming-threshold pixels are processed in strips when their chain allows it.
+ */
+
+#include <internal/image_processor.hpp>
+#include <internal/task_codec.hpp>
+#include <internal/worker_channel.hpp>
+
+#include <opencv2/core.hpp>
+#include <tbb/global_control.h>
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+using namespace image_processor;
+
+struct WorkerArguments {
+  std::string channel;
+  std::size_t slot = 0;
+  std::string output;
+  pid_t parent = 0;
+  int threads = 0; ///< 0 to leave OpenCV and TBB at their defaults.
+  std::uint64_t streaming_threshold = 0; ///< 0 to never stream.
+};
+
+bool ParseArguments(int argc, char** argv, WorkerArguments& arguments) {
+  bool has_slot = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    const auto equals = argument.find('=');
+    if (equals == std::string::npos) {
+      return false;
+    }
+
+    const std::string name = argument.substr(0, equals);
+    const std::string value = argument.substr(equals + 1);
+    try {
+      if (name == "--channel") {
+        arguments.channel = value;
+      } else if (name == "--slot") {
+        arguments.slot = std::stoul(value);
+        has_slot = true;
+      } else if (name == "--output") {
+        arguments.output = value;
+      } else if (name == "--parent") {
+        arguments.parent = static_cast<pid_t>(std::stol(value));
+      } else if (name == "--threads") {
+        arguments.threads = std::stoi(value);
+      } else if (name == "--streaming-threshold") {
+        arguments.streaming_threshold = std::stoull(value);
+      } else {
+        return false;
+      }
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+
+  return !arguments.channel.empty() && has_slot && !arguments.output.empty() &&
+         arguments.parent != 0;
+}
+
+WorkerResponse Process(const WorkerRequest& request, const WorkerSlot& slot,
+                       const WorkerArguments& arguments) {
+  WorkerResponse response{};
+  response.ticket = request.ticket;
+
+  Task task;
+  if (task_codec::DecodeTask(request.payload, request.size, task) == 0) {
+    response.error = ImageProcessingError::kInvalidFilter;
+    return response;
+  }
+
+  // A worker whose supervisor is gone stops like a cancelled task; nobody wants the
+  // result any more.
+  const auto is_cancelled = [&slot, &arguments, ticket = request.ticket] {
+    return slot.IsCancelled(ticket) || getppid() != arguments.parent;
+  };
+  if (is_cancelled()) {
+    response.error = ImageProcessingError::kCancelled;
+    response.skipped_filters =
+        static_cast<std::uint32_t>(task.operations->Filters().size());
+    return response;
+  }
+
+  ImageProcessor processor(task.image, *task.operations, arguments.output,
+                           arguments.streaming_threshold, is_cancelled);
+  try {
+    response.error = processor.ProcessImage();
+  } catch (const std::exception&) {
+    response.error = ImageProcessingError::kProcessingFailed;
+  }
+  response.decoded = true;
+  if (response.error == ImageProcessingError::kCancelled) {
+    response.skipped_filters =
+        static_cast<std::uint32_t>(processor.GetSkippedFilterCount());
+  } else if (response.error == ImageProcessingError::kNoError) {
+    const std::string result = processor.GetResultImagePath();
+    if (result.size() > WorkerResponse::kMaxResult) {
+      response.error = ImageProcessingError::kImageSaveError;
+    } else {
+      response.size = static_cast<std::uint32_t>(result.size());
+      std::memcpy(response.result, result.data(), result.size());
+    }
+  }
+  return response;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  WorkerArguments arguments;
+  if (!ParseArguments(argc, argv, arguments)) {
+    std::cerr << "usage: image_processor_worker --channel=NAME --slot=N --output=DIR "
+                 "--parent=PID [--threads=N] [--streaming-threshold=PIXELS]\n";
+    return 2;
+  }
+
+  // Never outlive the supervisor, even if it is killed without a chance to clean up: a
+  // worker is reparented when its supervisor exits. PR_SET_PDEATHSIG would fire when the
+  // spawning thread exits instead, which need not be the supervisor process.
+  const auto orphaned = [&arguments] { return getppid() != arguments.parent; };
+  if (orphaned()) {
+    return 1;
+  }
+
+  std::optional<tbb::global_control> thread_limit;
+  if (arguments.threads > 0) {
+    cv::setNumThreads(arguments.threads);
+    thread_limit.emplace(tbb::global_control::max_allowed_parallelism,
+                         static_cast<std::size_t>(arguments.threads));
+  }
+
+  try {
+    const SharedChannel channel = SharedChannel::Attach(arguments.channel);
+    if (arguments.slot >= channel->worker_count) {
+      std::cerr << "image_processor_worker: slot " << arguments.slot << " out of range\n";
+      return 2;
+    }
+
+    WorkerSlot& slot = channel->slots[arguments.slot];
+    IdleBackoff backoff;
+    auto request = std::make_unique<WorkerRequest>();
+    while (!channel->shutdown.load() && !orphaned()) {
+      if (!slot.requests.TryPop(*request)) {
+        backoff.Wait();
+        continue;
+      }
+      backoff.Reset();
+
+      slot.started_ns.store(MonotonicNanoseconds());
+      slot.current_ticket.store(request->ticket);
+      const WorkerResponse response = Process(*request, slot, arguments);
+      slot.current_ticket.store(0);
+
+      // The supervisor drains responses even while shutting down.
+      while (!slot.responses.TryPush(response) && !orphaned()) {
+        backoff.Wait();
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "image_processor_worker: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <image_processor/filter_factory.hpp>
+#include <internal/cancellation_registry.hpp>
+#include <internal/filter_chain.hpp>
+#include <internal/task_queue.hpp>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+namespace image_processor {
+namespace {
+
+constexpr std::size_t kTasks = 100000;
+
+std::filesystem::path SpillDirectory() {
+  return std::filesystem::temp_directory_path() /
+         ("cancellation_registry_test_" + std::to_string(getpid()));
+}
+
+Task MakeTask(std::size_t index, std::string tag = {}) {
+  return {"task-" + std::to_string(index), "/images/" + std::to_string(index) + ".jpg",
+          FilterChain::Intern(std::vector<Filter>{filter_factory::CreateBlurFilter(3)}),
+          std::move(tag)};
+}
+
+TEST(CancellationRegistryTest, SpilledBacklogIsNotTracked) {
+  CancellationRegistry registry;
+  TaskQueue queue;
+  queue.ConfigureSpill(1000, SpillDirectory());
+
+  for (std::size_t i = 0; i < kTasks; ++i) {
+    Task task = MakeTask(i, i % 2 == 0 ? "even" : "");
+    registry.Register(task);
+    queue.Push(std::move(task));
+  }
+  EXPECT_EQ(registry.Size(), 0u);
+
+  registry.Cancel("task-7");
+  registry.Cancel("unknown");
+  registry.CancelTag("even");
+  EXPECT_EQ(registry.Size(), 3u);
+
+  std::size_t cancelled = 0;
+  std::size_t popped = 0;
+  Task task;
+  while (queue.TryPop(task, 0)) {
+    cancelled += registry.IsCancelled(task) ? 1 : 0;
+    registry.Finish(task.id, task.sequence);
+    ++popped;
+    EXPECT_LE(registry.Size(), 3u);
+  }
+
+  EXPECT_EQ(popped, kTasks);
+  EXPECT_EQ(cancelled, kTasks / 2 + 1);
+  EXPECT_EQ(registry.Size(), 0u);
+  std::filesystem::remove_all(SpillDirectory());
+}
+
+TEST(CancellationRegistryTest, TagOnlyCancelsEarlierTasks) {
+  CancellationRegistry registry;
+  Task before = MakeTask(0, "batch");
+  registry.Register(before);
+  registry.CancelTag("batch");
+  Task after = MakeTask(1, "batch");
+  registry.Register(after);
+
+  EXPECT_TRUE(registry.IsCancelled(before));
+  EXPECT_FALSE(registry.IsCancelled(after));
+
+  // The tag is kept while a task registered before the cancellation is unfinished.
+  registry.Finish(after.id, after.sequence);
+  EXPECT_EQ(registry.Size(), 1u);
+  registry.Finish(before.id, before.sequence);
+  EXPECT_EQ(registry.Size(), 0u);
+}
+
+TEST(CancellationRegistryTest, CancellingWhileIdleKeepsNothing) {
+  CancellationRegistry registry;
+  Task task = MakeTask(0);
+  registry.Register(task);
+  registry.Finish(task.id, task.sequence);
+
+  registry.Cancel(task.id);
+  registry.CancelTag("batch");
+  EXPECT_EQ(registry.Size(), 0u);
+}
+
+} // namespace
+} // namespace image_processor
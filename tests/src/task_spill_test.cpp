@@ -0,0 +1,95 @@
+#include <image_processor/filter_factory.hpp>
+#include <internal/filter_chain.hpp>
+#include <internal/task_spill.hpp>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+namespace image_processor {
+namespace {
+
+// About 3 MB of records, so several flushes reach the segment file.
+constexpr std::size_t kTasks = 20000;
+
+class TaskSpillTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    directory_ = std::filesystem::temp_directory_path() /
+                 ("task_spill_test_" + std::to_string(getpid()));
+    chain_ =
+        FilterChain::Intern(std::vector<Filter>{filter_factory::CreateBlurFilter(3)});
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  Task MakeTask(std::size_t index) const {
+    return {"task-" + std::to_string(index),
+            "/images/" + std::string(100, 'x') + std::to_string(index) + ".jpg", chain_,
+            {}};
+  }
+
+  std::filesystem::path Segment() const {
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+      return entry.path();
+    }
+    return {};
+  }
+
+  std::filesystem::path directory_;
+  std::shared_ptr<const FilterChain> chain_;
+};
+
+TEST_F(TaskSpillTest, TruncatedSegmentReportsLostTasks) {
+  TaskSpill spill(directory_);
+  for (std::size_t i = 0; i < kTasks; ++i) {
+    ASSERT_TRUE(spill.Append(MakeTask(i)));
+  }
+
+  const auto segment = Segment();
+  ASSERT_FALSE(segment.empty());
+  std::filesystem::resize_file(segment, std::filesystem::file_size(segment) / 2 + 7);
+
+  std::vector<Task> tasks;
+  while (spill.ReadBatch(tasks, 1000) > 0) {
+  }
+
+  EXPECT_EQ(spill.Size(), 0u);
+  EXPECT_GT(spill.LostTasks(), 0u);
+  EXPECT_EQ(tasks.size() + spill.LostTasks(), kTasks);
+  EXPECT_TRUE(spill.Error());
+  // What was read before the truncation and what was still buffered survives, in order.
+  EXPECT_EQ(tasks.front().id, "task-0");
+  EXPECT_EQ(tasks.back().id, "task-" + std::to_string(kTasks - 1));
+  for (std::size_t i = 1; i < tasks.size(); ++i) {
+    EXPECT_LT(std::stoul(tasks[i - 1].id.substr(5)), std::stoul(tasks[i].id.substr(5)));
+  }
+
+  // The spill keeps working after dropping the segment.
+  ASSERT_TRUE(spill.Append(MakeTask(kTasks)));
+  tasks.clear();
+  EXPECT_EQ(spill.ReadBatch(tasks, 10), 1u);
+  EXPECT_EQ(tasks.front().id, "task-" + std::to_string(kTasks));
+}
+
+TEST_F(TaskSpillTest, DeletedSegmentReportsLostTasks) {
+  TaskSpill spill(directory_);
+  for (std::size_t i = 0; i < kTasks; ++i) {
+    ASSERT_TRUE(spill.Append(MakeTask(i)));
+  }
+  std::filesystem::remove(Segment());
+
+  std::vector<Task> tasks;
+  while (spill.ReadBatch(tasks, 1000) > 0) {
+  }
+
+  EXPECT_EQ(spill.Size(), 0u);
+  EXPECT_EQ(tasks.size() + spill.LostTasks(), kTasks);
+  EXPECT_GT(spill.LostTasks(), 0u);
+  EXPECT_EQ(spill.Error(), std::errc::no_such_file_or_directory);
+}
+
+} // namespace
+} // namespace image_processor
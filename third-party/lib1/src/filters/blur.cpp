@@ -1,11 +1,19 @@
 #include <lib1/filters/blur.h>
 
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
 namespace lib1 {
 
 void blur(cv::InputArray src, cv::OutputArray dst, cv::Size ksize) {
-  /**
-   * @todo To implement
-   */
+  // A kernel of 0 or 1 pixels leaves the image as it is.
+  if (ksize.width <= 1 && ksize.height <= 1) {
+    src.copyTo(dst);
+    return;
+  }
+
+  cv::blur(src, dst, cv::Size(std::max(ksize.width, 1), std::max(ksize.height, 1)));
 }
 
 } // namespace lib1
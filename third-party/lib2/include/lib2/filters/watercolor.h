@@ -4,6 +4,11 @@ namespace lib2 {
 
 /**
  * Turns an image into a watercolor painting.
+ *
+ * The image is smoothed with a disc-shaped brush, and pigment pools along the edges the
+ * brush softened. Brush kernels are computed once per size and hardness and then cached.
+ * Large frames are painted in bands of rows on several threads.
+ *
  * @param src input image.
  * @param dst output image of the same size and type as src.
  * @param brush_size painting brush size (from 0 to 1).
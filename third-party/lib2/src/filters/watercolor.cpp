@@ -1,12 +1,188 @@
 #include <lib2/filters/watercolor.h>
 
-namespace lib3 {
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lib2 {
+
+namespace {
+
+/**
+ * Radius, in pixels, of the largest brush (brush_size = 1).
+ */
+constexpr int kMaxBrushRadius = 15;
+
+/**
+ * Frames with fewer pixels are painted on the calling thread.
+ */
+constexpr int kParallelMinPixels = 512 * 512;
+
+/**
+ * Rows per band when a frame is split across threads.
+ */
+constexpr int kBandRows = 64;
+
+/**
+ * Cached kernels are dropped all at once past this many distinct parameter sets.
+ */
+constexpr std::size_t kMaxCachedKernels = 64;
+
+using BrushKey = std::pair<int, int>; // Radius, hardness in 1/255 steps.
+
+/**
+ * Builds a normalized disc-shaped brush. It is fully opaque up to hardness * radius,
+ * then fades out with a smoothstep, so a hard brush paints flat patches and a soft brush
+ * blends like a Gaussian.
+ */
+cv::Mat MakeBrushKernel(int radius, float hardness) {
+  const int size = 2 * radius + 1;
+  const float inner = hardness * radius;
+  const float outer = radius + 0.5f;
+  cv::Mat kernel(size, size, CV_32FC1);
+
+  float sum = 0;
+  for (int y = 0; y < size; ++y) {
+    float* row = kernel.ptr<float>(y);
+    for (int x = 0; x < size; ++x) {
+      const float distance = std::hypot(static_cast<float>(x - radius),
+                                        static_cast<float>(y - radius));
+      float weight = 0;
+      if (distance <= inner) {
+        weight = 1;
+      } else if (distance < outer) {
+        const float t = (distance - inner) / (outer - inner);
+        weight = 1 - t * t * (3 - 2 * t);
+      }
+      row[x] = weight;
+      sum += weight;
+    }
+  }
+
+  kernel.convertTo(kernel, CV_32FC1, 1.0 / sum);
+  return kernel;
+}
+
+/**
+ * Returns the kernel for a brush, computing it on first use. Kernels are immutable and
+ * shared, so threads painting with the same brush never recompute or copy it.
+ */
+std::shared_ptr<const cv::Mat> GetBrushKernel(float brush_size, float brush_hardness) {
+  static std::mutex mutex;
+  static std::map<BrushKey, std::shared_ptr<const cv::Mat>> cache;
+
+  const float size = std::clamp(brush_size, 0.0f, 1.0f);
+  const float hardness = std::clamp(brush_hardness, 0.0f, 1.0f);
+  const BrushKey key{1 + static_cast<int>(std::lround(size * (kMaxBrushRadius - 1))),
+                     static_cast<int>(std::lround(hardness * 255.0f))};
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    return it->second;
+  }
+
+  if (cache.size() >= kMaxCachedKernels) {
+    cache.clear();
+  }
+  auto kernel =
+      std::make_shared<const cv::Mat>(MakeBrushKernel(key.first, key.second / 255.0f));
+  cache.emplace(key, kernel);
+  return kernel;
+}
+
+/**
+ * Blends a row of the source with its brush-smoothed version. Pigment pools where the
+ * brush changed the image the most, darkening edges the way watercolor does:
+ * paint = smoothed - pooling * |source - smoothed|, out = source + strength * (paint -
+ * source).
+ */
+void BlendRow(const float* source, const float* smoothed, float* out, int count,
+              float strength, float pooling) {
+  int i = 0;
+
+#if defined(__SSE2__)
+  const __m128 strength4 = _mm_set1_ps(strength);
+  const __m128 pooling4 = _mm_set1_ps(pooling);
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  for (; i + 4 <= count; i += 4) {
+    const __m128 s = _mm_loadu_ps(source + i);
+    const __m128 m = _mm_loadu_ps(smoothed + i);
+    const __m128 difference = _mm_andnot_ps(sign_mask, _mm_sub_ps(s, m));
+    const __m128 paint = _mm_sub_ps(m, _mm_mul_ps(pooling4, difference));
+    _mm_storeu_ps(out + i, _mm_add_ps(s, _mm_mul_ps(strength4, _mm_sub_ps(paint, s))));
+  }
+#endif
+
+  for (; i < count; ++i) {
+    const float paint = smoothed[i] - pooling * std::fabs(source[i] - smoothed[i]);
+    out[i] = source[i] + strength * (paint - source[i]);
+  }
+}
+
+/**
+ * Paints rows [begin, end) of source into output.
+ */
+void PaintRows(const cv::Mat& source, cv::Mat& output, const cv::Mat& kernel, int begin,
+               int end, float strength, float pooling) {
+  // A row range of source is a view: filter2D reads the real neighbors above and below
+  // it and only applies the border at the edges of the whole image.
+  cv::Mat smoothed;
+  cv::filter2D(source.rowRange(begin, end), smoothed, CV_32F, kernel);
+
+  cv::Mat original;
+  source.rowRange(begin, end).convertTo(original, CV_32F);
+
+  cv::Mat painted(original.size(), original.type());
+  const int count = original.cols * original.channels();
+  for (int y = 0; y < original.rows; ++y) {
+    BlendRow(original.ptr<float>(y), smoothed.ptr<float>(y), painted.ptr<float>(y), count,
+             strength, pooling);
+  }
+
+  cv::Mat band = output.rowRange(begin, end);
+  painted.convertTo(band, output.type());
+}
+
+} // namespace
 
 void watercolor(cv::InputArray src, cv::OutputArray dst, float brush_size,
                 float brush_hardness, float brush_strength) {
-  /**
-   * @todo To implement
-   */
+  cv::Mat source = src.getMat();
+  dst.create(source.size(), source.type());
+  cv::Mat output = dst.getMat();
+  if (source.empty()) {
+    return;
+  }
+
+  // Bands read rows of their neighbors, so painting in place needs its own copy.
+  if (output.data == source.data) {
+    source = source.clone();
+  }
+
+  const auto kernel = GetBrushKernel(brush_size, brush_hardness);
+  const float strength = std::clamp(brush_strength, 0.0f, 1.0f);
+  const float pooling = 0.5f * std::clamp(brush_hardness, 0.0f, 1.0f);
+
+  if (source.total() < static_cast<std::size_t>(kParallelMinPixels)) {
+    PaintRows(source, output, *kernel, 0, source.rows, strength, pooling);
+    return;
+  }
+
+  const int bands = (source.rows + kBandRows - 1) / kBandRows;
+  cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+    PaintRows(source, output, *kernel, range.start * kBandRows,
+              std::min(range.end * kBandRows, source.rows), strength, pooling);
+  });
 }
 
-} // namespace lib3
+} // namespace lib2
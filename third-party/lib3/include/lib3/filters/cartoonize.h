@@ -4,10 +4,29 @@ namespace lib3 {
 
 /**
  * Create a cartoon picture from the image.
- * @param img input image.
+ *
+ * The image is smoothed with edge-preserving diffusion, its colors are quantized and
+ * dark outlines are drawn along the strongest edges. Lower detalization levels smooth
+ * more, use fewer colors and draw fewer outlines. The work is split into tiles that run
+ * in parallel.
+ *
+ * @param img input image, with values from 0 to 1.
  * @param detalizationLevel painting conversion detalization (from 0 to 1).
  * @return output image of the same size and type as img.
  */
 SIPL::Image<float> cartoonize(const SIPL::Image<float>& img, float detalizationLevel);
 
+/**
+ * Create a cartoon picture from a color image.
+ *
+ * Same as the single-channel overload. Edges are found on luminance, and smoothing
+ * preserves edges between colors of the same brightness.
+ *
+ * @param img input image, with channel values from 0 to 1.
+ * @param detalizationLevel painting conversion detalization (from 0 to 1).
+ * @return output image of the same size and type as img.
+ */
+SIPL::Image<SIPL::color_float> cartoonize(const SIPL::Image<SIPL::color_float>& img,
+                                          float detalizationLevel);
+
 } // namespace lib3
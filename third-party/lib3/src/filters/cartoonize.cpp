@@ -1,12 +1,421 @@
 #include <lib3/filters/cartoonize.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <tbb/blocked_range2d.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace lib3 {
 
+namespace {
+
+/**
+ * Side of the square tiles processed in parallel. A tile with its halo and scratch copy
+ * stays within a typical L2 cache.
+ */
+constexpr int kTileSize = 128;
+
+/**
+ * Diffusion step size; 4-neighbor diffusion is stable up to 0.25.
+ */
+constexpr float kDiffusionRate = 0.2f;
+
+/**
+ * Sobel responses are divided by this to bring a full black-to-white step to 1.
+ */
+constexpr float kSobelScale = 0.25f;
+
+struct CartoonParams {
+  int iterations;         // Diffusion iterations; each widens the halo by one pixel.
+  float inv_sigma2;       // 1 / sigma^2 of the edge-stopping function.
+  float levels;           // Quantization steps per channel, minus one.
+  float edge_threshold;   // Gradient magnitude at which outlines start.
+  float edge_gain;        // How fast outlines go from transparent to black.
+};
+
+CartoonParams MakeParams(float detalization_level) {
+  const float detail = std::clamp(detalization_level, 0.0f, 1.0f);
+  const float sigma = 0.04f + 0.16f * (1.0f - detail);
+
+  CartoonParams params;
+  params.iterations = 2 + static_cast<int>(std::lround((1.0f - detail) * 6.0f));
+  params.inv_sigma2 = 1.0f / (sigma * sigma);
+  params.levels = 2.0f + std::round(detail * 12.0f);
+  params.edge_threshold = 0.35f - 0.25f * detail;
+  params.edge_gain = 8.0f;
+  return params;
+}
+
+/**
+ * Planar float image: one contiguous plane per channel.
+ */
+template <int Channels>
+struct Planes {
+  int width = 0;
+  int height = 0;
+  std::vector<float> data;
+
+  void Resize(int new_width, int new_height) {
+    width = new_width;
+    height = new_height;
+    data.resize(static_cast<std::size_t>(width) * height * Channels);
+  }
+
+  float* Row(int channel, int y) {
+    return data.data() + (static_cast<std::size_t>(channel) * height + y) * width;
+  }
+
+  const float* Row(int channel, int y) const {
+    return data.data() + (static_cast<std::size_t>(channel) * height + y) * width;
+  }
+};
+
+template <int Channels>
+struct Scratch {
+  Planes<Channels> current;
+  Planes<Channels> next;
+  std::vector<float> luminance;
+};
+
+/**
+ * One Perona-Malik diffusion step on a row: every pixel moves towards its 4 neighbors,
+ * weighted by 1 / (1 + d^2 / sigma^2) where d is the color distance, so flat areas blur
+ * while strong edges stay put. Neighbors outside the buffer are clamped.
+ */
+template <int Channels>
+void DiffuseRow(const Planes<Channels>& src, Planes<Channels>& dst, int y,
+                float inv_sigma2) {
+  const int width = src.width;
+  const float* up[Channels];
+  const float* row[Channels];
+  const float* down[Channels];
+  float* out[Channels];
+  for (int c = 0; c < Channels; ++c) {
+    up[c] = src.Row(c, std::max(y - 1, 0));
+    row[c] = src.Row(c, y);
+    down[c] = src.Row(c, std::min(y + 1, src.height - 1));
+    out[c] = dst.Row(c, y);
+  }
+
+  const auto diffuse_pixel = [&](int x) {
+    const int left = std::max(x - 1, 0);
+    const int right = std::min(x + 1, width - 1);
+    float acc[Channels] = {};
+    const auto add = [&](const float* const* rows, int nx) {
+      float diff[Channels];
+      float d2 = 0;
+      for (int c = 0; c < Channels; ++c) {
+        diff[c] = rows[c][nx] - row[c][x];
+        d2 += diff[c] * diff[c];
+      }
+      const float g = 1.0f / (1.0f + d2 * inv_sigma2);
+      for (int c = 0; c < Channels; ++c) {
+        acc[c] += g * diff[c];
+      }
+    };
+    add(row, left);
+    add(row, right);
+    add(up, x);
+    add(down, x);
+    for (int c = 0; c < Channels; ++c) {
+      out[c][x] = row[c][x] + kDiffusionRate * acc[c];
+    }
+  };
+
+  diffuse_pixel(0);
+  int x = 1;
+
+#if defined(__SSE2__)
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 inv = _mm_set1_ps(inv_sigma2);
+  const __m128 rate = _mm_set1_ps(kDiffusionRate);
+  for (; x + 4 <= width - 1; x += 4) {
+    __m128 center[Channels];
+    __m128 acc[Channels];
+    for (int c = 0; c < Channels; ++c) {
+      center[c] = _mm_loadu_ps(row[c] + x);
+      acc[c] = _mm_setzero_ps();
+    }
+
+    const auto add = [&](const float* const* rows, int offset) {
+      __m128 diff[Channels];
+      __m128 d2 = _mm_setzero_ps();
+      for (int c = 0; c < Channels; ++c) {
+        diff[c] = _mm_sub_ps(_mm_loadu_ps(rows[c] + x + offset), center[c]);
+        d2 = _mm_add_ps(d2, _mm_mul_ps(diff[c], diff[c]));
+      }
+      const __m128 g = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(d2, inv)));
+      for (int c = 0; c < Channels; ++c) {
+        acc[c] = _mm_add_ps(acc[c], _mm_mul_ps(g, diff[c]));
+      }
+    };
+    add(row, -1);
+    add(row, 1);
+    add(up, 0);
+    add(down, 0);
+
+    for (int c = 0; c < Channels; ++c) {
+      _mm_storeu_ps(out[c] + x, _mm_add_ps(center[c], _mm_mul_ps(rate, acc[c])));
+    }
+  }
+#endif
+
+  for (; x < width; ++x) {
+    diffuse_pixel(x);
+  }
+}
+
+template <int Channels>
+void ComputeLuminance(const Planes<Channels>& planes, std::vector<float>& luminance) {
+  const std::size_t size = static_cast<std::size_t>(planes.width) * planes.height;
+  luminance.resize(size);
+  if constexpr (Channels == 1) {
+    std::memcpy(luminance.data(), planes.Row(0, 0), size * sizeof(float));
+  } else {
+    const float* red = planes.Row(0, 0);
+    const float* green = planes.Row(1, 0);
+    const float* blue = planes.Row(2, 0);
+    for (std::size_t i = 0; i < size; ++i) {
+      luminance[i] = 0.299f * red[i] + 0.587f * green[i] + 0.114f * blue[i];
+    }
+  }
+}
+
+/**
+ * Quantizes the smoothed colors of buffer row y, columns [x0, x1), darkens them along
+ * Sobel edges of the luminance and writes them to out. The rows and columns around the
+ * range must exist in the buffer.
+ */
+template <int Channels>
+void ComposeRow(const Planes<Channels>& smooth, const std::vector<float>& luminance,
+                int y, int x0, int x1, float* const* out, const CartoonParams& params) {
+  const int width = smooth.width;
+  const float* top = luminance.data() + static_cast<std::size_t>(y - 1) * width;
+  const float* middle = top + width;
+  const float* bottom = middle + width;
+  const float* row[Channels];
+  for (int c = 0; c < Channels; ++c) {
+    row[c] = smooth.Row(c, y);
+  }
+
+  const float steps = params.levels;
+  const float inv_steps = 1.0f / steps;
+
+  const auto compose_pixel = [&](int x) {
+    const float gx = (top[x + 1] + 2 * middle[x + 1] + bottom[x + 1]) -
+                     (top[x - 1] + 2 * middle[x - 1] + bottom[x - 1]);
+    const float gy = (bottom[x - 1] + 2 * bottom[x] + bottom[x + 1]) -
+                     (top[x - 1] + 2 * top[x] + top[x + 1]);
+    const float magnitude = std::sqrt(gx * gx + gy * gy) * kSobelScale;
+    const float edge =
+        std::clamp((magnitude - params.edge_threshold) * params.edge_gain, 0.0f, 1.0f);
+    for (int c = 0; c < Channels; ++c) {
+      const float value = std::clamp(row[c][x], 0.0f, 1.0f);
+      out[c][x - x0] = std::nearbyint(value * steps) * inv_steps * (1.0f - edge);
+    }
+  };
+
+  int x = x0;
+
+#if defined(__SSE2__)
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(kSobelScale);
+  const __m128 threshold = _mm_set1_ps(params.edge_threshold);
+  const __m128 gain = _mm_set1_ps(params.edge_gain);
+  const __m128 steps4 = _mm_set1_ps(steps);
+  const __m128 inv_steps4 = _mm_set1_ps(inv_steps);
+  for (; x + 4 <= x1; x += 4) {
+    const __m128 tl = _mm_loadu_ps(top + x - 1);
+    const __m128 tc = _mm_loadu_ps(top + x);
+    const __m128 tr = _mm_loadu_ps(top + x + 1);
+    const __m128 ml = _mm_loadu_ps(middle + x - 1);
+    const __m128 mr = _mm_loadu_ps(middle + x + 1);
+    const __m128 bl = _mm_loadu_ps(bottom + x - 1);
+    const __m128 bc = _mm_loadu_ps(bottom + x);
+    const __m128 br = _mm_loadu_ps(bottom + x + 1);
+
+    const __m128 gx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(tr, br), _mm_mul_ps(two, mr)),
+                                 _mm_add_ps(_mm_add_ps(tl, bl), _mm_mul_ps(two, ml)));
+    const __m128 gy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(bl, br), _mm_mul_ps(two, bc)),
+                                 _mm_add_ps(_mm_add_ps(tl, tr), _mm_mul_ps(two, tc)));
+    const __m128 squared = _mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy));
+    const __m128 magnitude = _mm_mul_ps(_mm_sqrt_ps(squared), scale);
+    const __m128 edge = _mm_min_ps(
+        one, _mm_max_ps(zero, _mm_mul_ps(_mm_sub_ps(magnitude, threshold), gain)));
+    const __m128 keep = _mm_sub_ps(one, edge);
+
+    for (int c = 0; c < Channels; ++c) {
+      const __m128 value = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(row[c] + x)));
+      // cvtps rounds to nearest even, like std::nearbyint in the scalar path.
+      const __m128 quantized =
+          _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(value, steps4)));
+      _mm_storeu_ps(out[c] + (x - x0),
+                    _mm_mul_ps(_mm_mul_ps(quantized, inv_steps4), keep));
+    }
+  }
+#endif
+
+  for (; x < x1; ++x) {
+    compose_pixel(x);
+  }
+}
+
+/**
+ * Cartoonizes one tile of the image. The tile is copied with a halo wide enough for every
+ * diffusion iteration plus the Sobel operator, with borders replicated, so tiles do not
+ * depend on each other and no seams appear between them.
+ */
+template <int Channels>
+void ProcessTile(const Planes<Channels>& image, Planes<Channels>& result, int tile_x,
+                 int tile_y, int tile_width, int tile_height, const CartoonParams& params,
+                 Scratch<Channels>& scratch) {
+  const int halo = params.iterations + 1;
+  const int buffer_width = tile_width + 2 * halo;
+  const int buffer_height = tile_height + 2 * halo;
+  scratch.current.Resize(buffer_width, buffer_height);
+  scratch.next.Resize(buffer_width, buffer_height);
+
+  // Columns [first, last) of the buffer map inside the image, the rest replicate its
+  // borders.
+  const int offset = tile_x - halo;
+  const int first = std::max(0, -offset);
+  const int last = std::min(buffer_width, image.width - offset);
+  for (int c = 0; c < Channels; ++c) {
+    for (int y = 0; y < buffer_height; ++y) {
+      const int source_y = std::clamp(tile_y - halo + y, 0, image.height - 1);
+      const float* source = image.Row(c, source_y);
+      float* destination = scratch.current.Row(c, y);
+      std::fill(destination, destination + first, source[0]);
+      std::memcpy(destination + first, source + offset + first,
+                  (last - first) * sizeof(float));
+      std::fill(destination + last, destination + buffer_width, source[image.width - 1]);
+    }
+  }
+
+  for (int iteration = 0; iteration < params.iterations; ++iteration) {
+    for (int y = 0; y < buffer_height; ++y) {
+      DiffuseRow(scratch.current, scratch.next, y, params.inv_sigma2);
+    }
+    std::swap(scratch.current, scratch.next);
+  }
+
+  ComputeLuminance(scratch.current, scratch.luminance);
+
+  float* out[Channels];
+  for (int y = 0; y < tile_height; ++y) {
+    for (int c = 0; c < Channels; ++c) {
+      out[c] = result.Row(c, tile_y + y) + tile_x;
+    }
+    ComposeRow(scratch.current, scratch.luminance, halo + y, halo, halo + tile_width, out,
+               params);
+  }
+}
+
+template <int Channels>
+void CartoonizePlanes(const Planes<Channels>& image, Planes<Channels>& result,
+                      float detalization_level) {
+  const CartoonParams params = MakeParams(detalization_level);
+  result.Resize(image.width, image.height);
+
+  const int tiles_x = (image.width + kTileSize - 1) / kTileSize;
+  const int tiles_y = (image.height + kTileSize - 1) / kTileSize;
+  tbb::enumerable_thread_specific<Scratch<Channels>> scratch;
+  const auto process_tiles = [&](const tbb::blocked_range2d<int>& range) {
+    Scratch<Channels>& local = scratch.local();
+    for (int ty = range.rows().begin(); ty < range.rows().end(); ++ty) {
+      for (int tx = range.cols().begin(); tx < range.cols().end(); ++tx) {
+        const int x = tx * kTileSize;
+        const int y = ty * kTileSize;
+        ProcessTile(image, result, x, y, std::min(kTileSize, image.width - x),
+                    std::min(kTileSize, image.height - y), params, local);
+      }
+    }
+  };
+  tbb::parallel_for(tbb::blocked_range2d<int>(0, tiles_y, 0, tiles_x), process_tiles);
+}
+
+} // namespace
+
 SIPL::Image<float> cartoonize(const SIPL::Image<float>& img, float detalizationLevel) {
-  /**
-   * @todo To implement
-   */
-  return img;
+  const int width = img.getWidth();
+  const int height = img.getHeight();
+  if (width <= 0 || height <= 0) {
+    return img;
+  }
+
+  Planes<1> planes;
+  planes.Resize(width, height);
+  for (int y = 0; y < height; ++y) {
+    float* row = planes.Row(0, y);
+    for (int x = 0; x < width; ++x) {
+      row[x] = img.get(x, y);
+    }
+  }
+
+  Planes<1> result;
+  CartoonizePlanes(planes, result, detalizationLevel);
+
+  SIPL::Image<float> output(width, height);
+  for (int y = 0; y < height; ++y) {
+    const float* row = result.Row(0, y);
+    for (int x = 0; x < width; ++x) {
+      output.set(x, y, row[x]);
+    }
+  }
+  return output;
+}
+
+SIPL::Image<SIPL::color_float> cartoonize(const SIPL::Image<SIPL::color_float>& img,
+                                          float detalizationLevel) {
+  const int width = img.getWidth();
+  const int height = img.getHeight();
+  if (width <= 0 || height <= 0) {
+    return img;
+  }
+
+  Planes<3> planes;
+  planes.Resize(width, height);
+  for (int y = 0; y < height; ++y) {
+    float* red = planes.Row(0, y);
+    float* green = planes.Row(1, y);
+    float* blue = planes.Row(2, y);
+    for (int x = 0; x < width; ++x) {
+      const SIPL::color_float color = img.get(x, y);
+      red[x] = color.red;
+      green[x] = color.green;
+      blue[x] = color.blue;
+    }
+  }
+
+  Planes<3> result;
+  CartoonizePlanes(planes, result, detalizationLevel);
+
+  SIPL::Image<SIPL::color_float> output(width, height);
+  for (int y = 0; y < height; ++y) {
+    const float* red = result.Row(0, y);
+    const float* green = result.Row(1, y);
+    const float* blue = result.Row(2, y);
+    for (int x = 0; x < width; ++x) {
+      SIPL::color_float color;
+      color.red = red[x];
+      color.green = green[x];
+      color.blue = blue[x];
+      output.set(x, y, color);
+    }
+  }
+  return output;
 }
 
 } // namespace lib3
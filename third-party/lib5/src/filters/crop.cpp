@@ -3,9 +3,9 @@
 namespace lib5 {
 
 void crop(const cv::Mat& src, cv::Mat& dst, const cv::Rect& rect) {
-  /**
-   * @todo To implement
-   */
+  // Copied, so the crop owns its pixels even when dst is src; throws cv::Exception if
+  // the rectangle does not fit the image.
+  dst = src(rect).clone();
 }
 
 } // namespace lib5